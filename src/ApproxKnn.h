@@ -0,0 +1,14 @@
+#pragma once
+#include "Point.h"
+#include <vector>
+
+using namespace std;
+
+// Result of an approximate k-NN search. exact is true when no node that could
+// still hold a closer point was skipped, i.e. neighbors equals knn_query's answer.
+struct ApproxKnnResult {
+    vector<pair<Point, float>> neighbors;
+    bool exact;
+    int visited_nodes;
+    int visited_leaves;
+};
@@ -0,0 +1,225 @@
+#include "AutoTuner.h"
+#include "TreeStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+using namespace std;
+
+AutoTuner::AutoTuner()
+    : capacities{4, 8, 16, 32, 64},
+      fanouts{8, 16, 32, 64},
+      methods{SortMethod::STR, SortMethod::Z_ORDER},
+      sample_fraction(0.1f),
+      use_cost_model(false),
+      timed_candidates(3),
+      timing_repetitions(5) {}
+
+ostream& operator<<(ostream& os, const IndexConfig& config) {
+    if (config.type == IndexType::QUAD_TREE) {
+        os << "QuadTree(capacity=" << config.capacity << ")";
+    } else {
+        os << "RTree(min=" << config.min_entries << ", max=" << config.max_entries
+           << ", " << (config.method == SortMethod::STR ? "STR" : "Z_ORDER") << ")";
+    }
+    return os;
+}
+
+// Evenly strided subsample, so the spatial distribution is preserved
+static vector<Point> subsample(const vector<Point>& points, float fraction) {
+    if (fraction >= 1.0f) return points;
+    size_t target = max<size_t>(1, static_cast<size_t>(points.size() * fraction));
+    double stride = static_cast<double>(points.size()) / target;
+    vector<Point> sample;
+    sample.reserve(target);
+    for (size_t i = 0; i < target; ++i) {
+        sample.push_back(points[static_cast<size_t>(i * stride)]);
+    }
+    return sample;
+}
+
+// Runs the whole workload once through the regular query paths, returns the
+// number of results so the calls cannot be optimized away
+template <typename Tree>
+static size_t run_workload(const Tree& tree, const Workload& workload) {
+    size_t sink = 0;
+    for (const Rectangle& r : workload.range_queries) {
+        sink += tree.range_query(r).size();
+    }
+    for (const Point& q : workload.knn_queries) {
+        sink += tree.knn_query(q, workload.k).size();
+    }
+    return sink;
+}
+
+// μs per query over the whole workload: one untimed warm-up pass to fault in
+// the freshly built tree, then the median of the timed repetitions
+template <typename Tree>
+static float time_workload(const Tree& tree, const Workload& workload, int repetitions) {
+    size_t total_queries = workload.range_queries.size() + workload.knn_queries.size();
+    if (total_queries == 0) return 0.0f;
+
+    size_t sink = run_workload(tree, workload);
+    vector<float> timings;
+    for (int i = 0; i < max(repetitions, 1); ++i) {
+        auto start = chrono::steady_clock::now();
+        sink += run_workload(tree, workload);
+        auto end = chrono::steady_clock::now();
+        timings.push_back(chrono::duration<float, micro>(end - start).count() / total_queries);
+    }
+
+    volatile size_t keep = sink;
+    (void)keep;
+    nth_element(timings.begin(), timings.begin() + timings.size() / 2, timings.end());
+    return timings[timings.size() / 2];
+}
+
+// Expected number of leaves a w x h window touches on a grid of square leaves
+// of the given area (Minkowski sum of the window and one leaf).
+static float leaves_touched(float w, float h, float leaf_area) {
+    float side = sqrt(leaf_area);
+    return leaf_area > 0 ? (w + side) * (h + side) / leaf_area : 1.0f;
+}
+
+// Entries examined per query: descent cost plus the points of every leaf the
+// query window (a k-NN query is treated as the square expected to hold k
+// points) touches.
+static float window_cost(const Workload& workload, float root_area, int total_points,
+                         float depth, float fanout, float leaf_area, float points_per_leaf) {
+    size_t total_queries = workload.range_queries.size() + workload.knn_queries.size();
+    if (total_queries == 0 || total_points == 0) return 0.0f;
+
+    float cost = 0.0f;
+    for (const Rectangle& r : workload.range_queries) {
+        cost += depth * fanout + leaves_touched(r.w, r.h, leaf_area) * points_per_leaf;
+    }
+    float knn_side = sqrt(root_area * workload.k / total_points);
+    cost += workload.knn_queries.size() *
+            (depth * fanout + leaves_touched(knn_side, knn_side, leaf_area) * points_per_leaf);
+    return cost / total_queries;
+}
+
+float AutoTuner::model_cost(const QuadTree& tree, const Workload& workload) const {
+    QuadTreeStats stats = tree.collect_stats();
+    if (stats.total_leaves == 0) return 0.0f;
+
+    float depth = (stats.min_depth + stats.max_depth) / 2.0f;
+    float leaf_area = tree.boundary.area() / stats.total_leaves;
+    return window_cost(workload, tree.boundary.area(), stats.total_points,
+                       depth, 4.0f, leaf_area, stats.avg_points_per_leaf);
+}
+
+float AutoTuner::model_cost(const RTree& tree, const Workload& workload) const {
+    TreeStats stats = compute_stats(tree);
+    int total_points = stats.total_points;
+    if (total_points == 0) return 0.0f;
+
+    float points_per_leaf = min(static_cast<float>(tree.max_entries), static_cast<float>(total_points));
+    float leaves = total_points / points_per_leaf;
+    float leaf_area = tree.boundary.area() / leaves;
+
+    // Sibling overlap at the leaf level makes a window touch proportionally more leaves
+    float overlap_factor = (!stats.levels.empty() && leaf_area > 0) ? 1.0f + stats.levels.back().avg_overlap / leaf_area : 1.0f;
+
+    return overlap_factor * window_cost(workload, tree.boundary.area(), total_points, stats.max_depth + 1,
+                                        stats.avg_occupancy, leaf_area, points_per_leaf);
+}
+
+variant<unique_ptr<QuadTree>, unique_ptr<RTree>> AutoTuner::build(const vector<Point>& points, const IndexConfig& config) const {
+    if (config.type == IndexType::QUAD_TREE) {
+        Rectangle boundary = Rectangle::bounding(points, 1e-4f);
+        auto tree = make_unique<QuadTree>(boundary, config.capacity);
+        for (const Point& p : points) {
+            tree->insert(p);
+        }
+        return tree;
+    }
+
+    auto tree = make_unique<RTree>(Rectangle(0, 0, 0, 0), config.min_entries, config.max_entries);
+    tree->insert(points, config.method);
+    return tree;
+}
+
+TuningResult AutoTuner::tune(const vector<Point>& points, const Workload& workload) const {
+    TuningResult result;
+
+    vector<IndexConfig> configs;
+    for (int capacity : capacities) {
+        configs.push_back(IndexConfig{IndexType::QUAD_TREE, capacity, 0, 0, SortMethod::STR});
+    }
+    for (int fanout : fanouts) {
+        int min_entries = max(2, static_cast<int>(fanout * 0.4f));
+        for (SortMethod method : methods) {
+            configs.push_back(IndexConfig{IndexType::R_TREE, 0, min_entries, fanout, method});
+        }
+    }
+    if (configs.empty() || points.empty()) {
+        result.best = configs.empty() ? IndexConfig{IndexType::QUAD_TREE, 16, 0, 0, SortMethod::STR} : configs[0];
+        return result;
+    }
+
+    vector<Point> sample = subsample(points, sample_fraction);
+    for (const IndexConfig& config : configs) {
+        result.candidates.push_back(CandidateResult{config, -1.0f, -1.0f});
+    }
+
+    // Rank by the cost model first and only time the most promising candidates,
+    // reusing the indexes the model pass built for them
+    size_t to_time = result.candidates.size();
+    vector<variant<unique_ptr<QuadTree>, unique_ptr<RTree>>> built;
+    if (use_cost_model) {
+        for (CandidateResult& candidate : result.candidates) {
+            built.push_back(build(sample, candidate.config));
+            auto& index = built.back();
+            if (holds_alternative<unique_ptr<QuadTree>>(index)) {
+                candidate.model_cost = model_cost(*get<unique_ptr<QuadTree>>(index), workload);
+            } else {
+                candidate.model_cost = model_cost(*get<unique_ptr<RTree>>(index), workload);
+            }
+        }
+
+        vector<size_t> order(result.candidates.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&result](size_t a, size_t b) {
+            return result.candidates[a].model_cost < result.candidates[b].model_cost;
+        });
+        to_time = min(to_time, static_cast<size_t>(max(timed_candidates, 1)));
+
+        vector<CandidateResult> ranked;
+        vector<variant<unique_ptr<QuadTree>, unique_ptr<RTree>>> kept;
+        for (size_t i = 0; i < order.size(); ++i) {
+            ranked.push_back(result.candidates[order[i]]);
+            if (i < to_time) kept.push_back(move(built[order[i]]));
+        }
+        result.candidates = move(ranked);
+        built = move(kept);
+    }
+
+    float best_cost = numeric_limits<float>::infinity();
+    result.best = result.candidates[0].config;
+    for (size_t i = 0; i < to_time; ++i) {
+        CandidateResult& candidate = result.candidates[i];
+        auto index = built.empty() ? build(sample, candidate.config) : move(built[i]);
+        if (holds_alternative<unique_ptr<QuadTree>>(index)) {
+            candidate.measured_cost = time_workload(*get<unique_ptr<QuadTree>>(index), workload, timing_repetitions);
+        } else {
+            candidate.measured_cost = time_workload(*get<unique_ptr<RTree>>(index), workload, timing_repetitions);
+        }
+        if (candidate.measured_cost < best_cost) {
+            best_cost = candidate.measured_cost;
+            result.best = candidate.config;
+        }
+    }
+
+    return result;
+}
+
+variant<unique_ptr<QuadTree>, unique_ptr<RTree>> AutoTuner::tune_and_build(const vector<Point>& points, const Workload& workload, TuningResult* result) const {
+    TuningResult tuning = tune(points, workload);
+    auto index = build(points, tuning.best);
+    if (result) *result = move(tuning);
+    return index;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include "QuadTree.h"
+#include "RTree.h"
+#include <vector>
+#include <variant>
+#include <memory>
+
+using namespace std;
+
+enum class IndexType {QUAD_TREE, R_TREE};
+
+struct IndexConfig {
+    IndexType type;
+    int capacity;       // QuadTree only
+    int min_entries;    // RTree only
+    int max_entries;    // RTree only
+    SortMethod method;  // RTree only
+};
+
+// A sample of the query log. The ratio of range to k-NN queries in it is the
+// mix the tuner optimizes for.
+struct Workload {
+    vector<Rectangle> range_queries;
+    vector<Point> knn_queries;
+    int k;
+};
+
+struct CandidateResult {
+    IndexConfig config;
+    float model_cost;     // estimated entries examined per query (cost model)
+    float measured_cost;  // median μs per query on the subsample, negative if not timed
+};
+
+struct TuningResult {
+    IndexConfig best;
+    vector<CandidateResult> candidates;
+};
+
+class AutoTuner {
+public:
+    vector<int> capacities;           // QuadTree capacities to try
+    vector<int> fanouts;              // RTree max_entries to try (min_entries = 40%)
+    vector<SortMethod> methods;
+    float sample_fraction;            // fraction of the dataset each candidate is built on
+    bool use_cost_model;              // rank by collect_stats/overlap model before timing
+    int timed_candidates;             // with the cost model, only the best N are timed
+    int timing_repetitions;           // timed runs per candidate after a warm-up, median is kept
+
+    AutoTuner();
+
+    TuningResult tune(const vector<Point>& points, const Workload& workload) const;
+    variant<unique_ptr<QuadTree>, unique_ptr<RTree>> build(const vector<Point>& points, const IndexConfig& config) const;
+    variant<unique_ptr<QuadTree>, unique_ptr<RTree>> tune_and_build(const vector<Point>& points, const Workload& workload, TuningResult* result = nullptr) const;
+
+    float model_cost(const QuadTree& tree, const Workload& workload) const;
+    float model_cost(const RTree& tree, const Workload& workload) const;
+};
+
+ostream& operator<<(ostream& os, const IndexConfig& config);
@@ -0,0 +1,346 @@
+#include "Harness.h"
+#include "QuadTree.h"
+#include "RTree.h"
+#include "HybridRTree.h"
+#include "TransformedIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+vector<Point> load_points(const string& path) {
+    vector<Point> points;
+    ifstream in(path);
+    string line;
+    int id = 0;
+    while (getline(in, line)) {
+        float x, y;
+        char comma;
+        istringstream fields(line);
+        if (fields >> x >> comma >> y) {
+            points.emplace_back(id++, x, y);
+        }
+    }
+    return points;
+}
+
+vector<Rectangle> load_rectangles(const string& path) {
+    vector<Rectangle> rects;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        float x, y, w, h;
+        char comma;
+        istringstream fields(line);
+        if (fields >> x >> comma >> y >> comma >> w >> comma >> h) {
+            rects.emplace_back(x, y, w, h);
+        }
+    }
+    return rects;
+}
+
+QueryGenerator::QueryGenerator(const vector<Point>& points, unsigned seed)
+    : bounds(Rectangle::bounding(points)), rng(seed) {}
+
+vector<Rectangle> QueryGenerator::random_ranges(int n, float min_area_fraction, float max_area_fraction) {
+    uniform_real_distribution<float> x(bounds.left, bounds.right), y(bounds.bottom, bounds.top);
+    uniform_real_distribution<float> fraction(min_area_fraction, max_area_fraction);
+    uniform_real_distribution<float> aspect(0.25f, 4.0f);
+
+    vector<Rectangle> ranges;
+    for (int i = 0; i < n; ++i) {
+        float area = fraction(rng) * bounds.area();
+        float a = aspect(rng);
+        ranges.emplace_back(x(rng), y(rng), sqrt(area * a), sqrt(area / a));
+    }
+    return ranges;
+}
+
+vector<Point> QueryGenerator::random_points(int n) {
+    uniform_real_distribution<float> x(bounds.left, bounds.right), y(bounds.bottom, bounds.top);
+    vector<Point> queries;
+    for (int i = 0; i < n; ++i) {
+        queries.emplace_back(-1, x(rng), y(rng));
+    }
+    return queries;
+}
+
+vector<Rectangle> QueryGenerator::adversarial_ranges(const vector<Point>& points, int n) {
+    vector<Rectangle> ranges;
+    if (points.empty()) return ranges;
+
+    uniform_int_distribution<size_t> pick(0, points.size() - 1);
+    float span = max(bounds.w, bounds.h);
+
+    ranges.push_back(bounds);
+    ranges.emplace_back(bounds.x, bounds.y, bounds.w * 4, bounds.h * 4);
+    ranges.emplace_back(bounds.right + span, bounds.top + span, span / 10, span / 10);
+    ranges.emplace_back(bounds.left, bounds.y, span / 100, bounds.h);
+    ranges.emplace_back(bounds.x, bounds.top, bounds.w, span / 100);
+    ranges.emplace_back(bounds.x, bounds.y, 0, 0);
+
+    while (static_cast<int>(ranges.size()) < n) {
+        const Point& p = points[pick(rng)];
+        switch (ranges.size() % 3) {
+            case 0: ranges.emplace_back(p.x, p.y, 0, 0); break;
+            case 1: ranges.emplace_back(p.x, p.y, span * 1e-6f, span * 1e-6f); break;
+            default: ranges.emplace_back(p.x + span * 1e-3f, p.y, span * 2e-3f, 0); break; // p on the left edge
+        }
+    }
+    return ranges;
+}
+
+vector<Point> QueryGenerator::adversarial_points(const vector<Point>& points, int n) {
+    vector<Point> queries;
+    if (points.empty()) return queries;
+
+    uniform_int_distribution<size_t> pick(0, points.size() - 1);
+    float span = max(bounds.w, bounds.h);
+
+    queries.emplace_back(-1, bounds.left, bounds.bottom);
+    queries.emplace_back(-1, bounds.right, bounds.top);
+    queries.emplace_back(-1, bounds.x, bounds.y);
+    queries.emplace_back(-1, bounds.right + 10 * span, bounds.y);
+    queries.emplace_back(-1, bounds.x, bounds.bottom - 10 * span);
+
+    while (static_cast<int>(queries.size()) < n) {
+        const Point& p = points[pick(rng)];
+        queries.emplace_back(-1, p.x, p.y);
+    }
+    return queries;
+}
+
+vector<Point> with_duplicates(const vector<Point>& points, int copies_per_point, int every_nth, unsigned seed) {
+    vector<Point> out = points;
+    int next_id = 0;
+    for (const Point& p : points) next_id = max(next_id, p.id + 1);
+
+    mt19937 rng(seed);
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (every_nth > 1 && rng() % every_nth != 0) continue;
+        for (int c = 0; c < copies_per_point; ++c) {
+            out.emplace_back(next_id++, points[i].x, points[i].y);
+        }
+    }
+    return out;
+}
+
+// Wraps a single-query function into the batched shape IndexVariant uses
+template <typename Index>
+static IndexVariant single_query_variant(const string& name, shared_ptr<Index> index) {
+    return IndexVariant{
+        name,
+        [index](const vector<Rectangle>& ranges) {
+            vector<vector<Point>> results;
+            for (const Rectangle& r : ranges) results.push_back(index->range_query(r));
+            return results;
+        },
+        [index](const vector<Point>& queries, int k) {
+            vector<vector<pair<Point, float>>> results;
+            for (const Point& q : queries) results.push_back(index->knn_query(q, k));
+            return results;
+        }};
+}
+
+template <typename Tree>
+static IndexVariant batched_variant(const string& name, shared_ptr<Tree> tree) {
+    return IndexVariant{
+        name,
+        [tree](const vector<Rectangle>& ranges) { return tree->range_query_batch(ranges); },
+        [tree](const vector<Point>& queries, int k) { return tree->knn_query_batch(queries, k); }};
+}
+
+vector<IndexVariant> standard_variants(const vector<Point>& points) {
+    vector<IndexVariant> variants;
+
+    Rectangle boundary = Rectangle::bounding(points, 1e-4f);
+
+    auto quad = make_shared<QuadTree>(boundary, 16);
+    auto quad_bounded = make_shared<QuadTree>(boundary, 16, 16);
+    for (const Point& p : points) {
+        quad->insert(p);
+        quad_bounded->insert(p);
+    }
+    variants.push_back(single_query_variant("QuadTree(16)", quad));
+    variants.push_back(single_query_variant("QuadTree(16, max_depth=16)", quad_bounded));
+    variants.push_back(batched_variant("QuadTree(16) batched", quad));
+
+    for (SortMethod method : {SortMethod::STR, SortMethod::Z_ORDER}) {
+        string name = method == SortMethod::STR ? "RTree(STR)" : "RTree(Z_ORDER)";
+        auto rtree = make_shared<RTree>(Rectangle(0, 0, 0, 0), 4, 16);
+        rtree->insert(points, method);
+        variants.push_back(single_query_variant(name, rtree));
+        if (method == SortMethod::STR) {
+            variants.push_back(batched_variant(name + " batched", rtree));
+        }
+    }
+
+    // Bulk loaded except for a tail that is still in the write buffer
+    size_t buffered = min<size_t>(points.size() / 20, 4096);
+    size_t packed = points.size() - buffered;
+    auto hybrid = make_shared<HybridRTree>(4, 16, SortMethod::STR, points.size() + 1, chrono::milliseconds(1000));
+    hybrid->bulk_load(vector<Point>(points.begin(), points.begin() + packed));
+    for (size_t i = packed; i < points.size(); ++i) {
+        hybrid->insert(points[i]);
+    }
+    variants.push_back(single_query_variant("HybridRTree(STR, " + to_string(buffered) + " buffered)", hybrid));
+
+    SpaceTransform pca = SpaceTransform::fit_pca(points);
+    auto rotated_quad = make_shared<TransformedIndex<QuadTree>>(build_transformed_quadtree(points, 16, pca));
+    auto rotated_rtree = make_shared<TransformedIndex<RTree>>(build_transformed_rtree(points, 4, 16, SortMethod::STR, pca));
+    variants.push_back(single_query_variant("QuadTree(16) PCA", rotated_quad));
+    variants.push_back(single_query_variant("RTree(STR) PCA", rotated_rtree));
+
+    return variants;
+}
+
+// Every returned point must be a stored point, coordinates included
+static bool is_stored(const Point& p, const unordered_map<int, Point>& by_id) {
+    auto it = by_id.find(p.id);
+    return it != by_id.end() && it->second.x == p.x && it->second.y == p.y;
+}
+
+// Range answers must hold exactly the oracle's ids (as a multiset)
+static bool same_range_result(const vector<Point>& expected, const vector<Point>& actual,
+                              const unordered_map<int, Point>& by_id) {
+    vector<int> a, b;
+    for (const Point& p : expected) a.push_back(p.id);
+    for (const Point& p : actual) {
+        if (!is_stored(p, by_id)) return false;
+        b.push_back(p.id);
+    }
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    return a == b;
+}
+
+// k-NN answers must have exactly the oracle's distances and ids. Only among the
+// points tied at the k-th distance may the choice differ; those must still be
+// distinct stored points at exactly that distance.
+static bool same_knn_result(const vector<pair<Point, float>>& expected, const vector<pair<Point, float>>& actual,
+                            const Point& query, const unordered_map<int, Point>& by_id) {
+    if (expected.size() != actual.size()) return false;
+    if (expected.empty()) return true;
+
+    float kth = expected.back().second;
+    vector<int> a, b, tied;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const Point& p = actual[i].first;
+        if (expected[i].second != actual[i].second || !is_stored(p, by_id) || query.distance_to_point(p) != actual[i].second)
+            return false;
+        if (expected[i].second < kth) {
+            a.push_back(expected[i].first.id);
+            b.push_back(p.id);
+        } else {
+            tied.push_back(p.id);
+        }
+    }
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    sort(tied.begin(), tied.end());
+    return a == b && adjacent_find(tied.begin(), tied.end()) == tied.end();
+}
+
+// Median time of fn over the repetitions, after an untimed warm-up run. The
+// result of the last run is kept in out; the previous one is released outside
+// the timed region.
+template <typename Fn, typename Result>
+static double time_us(Fn&& fn, Result& out, int repetitions) {
+    out = fn();
+    vector<double> timings;
+    for (int i = 0; i < max(repetitions, 1); ++i) {
+        auto start = chrono::steady_clock::now();
+        Result result = fn();
+        auto end = chrono::steady_clock::now();
+        timings.push_back(chrono::duration<double, micro>(end - start).count());
+        out = move(result);
+    }
+
+    nth_element(timings.begin(), timings.begin() + timings.size() / 2, timings.end());
+    return timings[timings.size() / 2];
+}
+
+vector<VariantReport> run_harness(const vector<Point>& points, const vector<IndexVariant>& variants,
+                                  const vector<Rectangle>& ranges, const vector<Point>& knn_queries,
+                                  const vector<int>& ks, ostream* log, int repetitions) {
+    NaiveIndex naive(points);
+    unordered_map<int, Point> by_id;
+    for (const Point& p : points) by_id.emplace(p.id, p);
+
+    vector<vector<Point>> expected_ranges;
+    double naive_range_us = time_us([&] {
+        vector<vector<Point>> found;
+        for (const Rectangle& r : ranges) found.push_back(naive.range_query(r));
+        return found;
+    }, expected_ranges, repetitions);
+
+    vector<vector<vector<pair<Point, float>>>> expected_knn;
+    double naive_knn_us = time_us([&] {
+        vector<vector<vector<pair<Point, float>>>> found;
+        for (int k : ks) {
+            found.emplace_back();
+            for (const Point& q : knn_queries) found.back().push_back(naive.knn_query(q, k));
+        }
+        return found;
+    }, expected_knn, repetitions);
+
+    size_t knn_total = knn_queries.size() * ks.size();
+    auto per_query = [](double total, size_t count) { return count > 0 ? total / count : 0.0; };
+
+    vector<VariantReport> reports;
+    reports.push_back(VariantReport{"Naive scan", ranges.size(), 0, knn_total, 0,
+                                    per_query(naive_range_us, ranges.size()), per_query(naive_knn_us, knn_total), 1.0, 1.0});
+
+    for (const IndexVariant& variant : variants) {
+        VariantReport report{variant.name, ranges.size(), 0, knn_total, 0, 0, 0, 0, 0};
+
+        vector<vector<Point>> range_results;
+        double range_us = time_us([&] { return variant.range(ranges); }, range_results, repetitions);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (!same_range_result(expected_ranges[i], range_results[i], by_id)) {
+                report.range_mismatches++;
+                if (log) *log << variant.name << ": range mismatch for " << ranges[i] << " (expected "
+                              << expected_ranges[i].size() << ", got " << range_results[i].size() << ")\n";
+            }
+        }
+
+        double knn_us = 0;
+        for (size_t j = 0; j < ks.size(); ++j) {
+            vector<vector<pair<Point, float>>> knn_results;
+            knn_us += time_us([&] { return variant.knn(knn_queries, ks[j]); }, knn_results, repetitions);
+            for (size_t i = 0; i < knn_queries.size(); ++i) {
+                if (!same_knn_result(expected_knn[j][i], knn_results[i], knn_queries[i], by_id)) {
+                    report.knn_mismatches++;
+                    if (log) *log << variant.name << ": k-NN mismatch for " << knn_queries[i] << ", k=" << ks[j] << "\n";
+                }
+            }
+        }
+
+        report.range_us = per_query(range_us, ranges.size());
+        report.knn_us = per_query(knn_us, knn_total);
+        report.range_speedup = report.range_us > 0 ? reports[0].range_us / report.range_us : 0.0;
+        report.knn_speedup = report.knn_us > 0 ? reports[0].knn_us / report.knn_us : 0.0;
+        reports.push_back(report);
+    }
+
+    return reports;
+}
+
+void print_report(ostream& os, const vector<VariantReport>& reports) {
+    os << left << setw(34) << "variant"
+       << right << setw(12) << "range μs" << setw(10) << "speedup" << setw(12) << "mismatch"
+       << setw(12) << "k-NN μs" << setw(10) << "speedup" << setw(12) << "mismatch" << "\n";
+    for (const VariantReport& r : reports) {
+        os << left << setw(34) << r.name << right << fixed << setprecision(2)
+           << setw(12) << r.range_us << setw(9) << r.range_speedup << "x"
+           << setw(12) << (to_string(r.range_mismatches) + "/" + to_string(r.range_queries))
+           << setw(12) << r.knn_us << setw(9) << r.knn_speedup << "x"
+           << setw(12) << (to_string(r.knn_mismatches) + "/" + to_string(r.knn_queries)) << "\n";
+    }
+}
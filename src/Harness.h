@@ -0,0 +1,67 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include "NaiveIndex.h"
+#include <vector>
+#include <string>
+#include <functional>
+#include <random>
+#include <iostream>
+
+using namespace std;
+
+// Input files in the T2/T5 layout: points are "x,y" per line (the line number
+// becomes the id), range queries are "x,y,w,h" (center and size).
+vector<Point> load_points(const string& path);
+vector<Rectangle> load_rectangles(const string& path);
+
+// Random and adversarial queries over the bounds of a dataset
+class QueryGenerator {
+public:
+    Rectangle bounds;
+    mt19937 rng;
+
+    explicit QueryGenerator(const vector<Point>& points, unsigned seed = 42);
+
+    vector<Rectangle> random_ranges(int n, float min_area_fraction, float max_area_fraction);
+    vector<Point> random_points(int n);
+    // Zero-area and tiny rectangles on data points, the whole space, ranges
+    // straddling or entirely outside the bounds
+    vector<Rectangle> adversarial_ranges(const vector<Point>& points, int n);
+    // Exact data points, points on the bounds and far outside them
+    vector<Point> adversarial_points(const vector<Point>& points, int n);
+};
+
+// Appends copies of existing points (new ids, same coordinates)
+vector<Point> with_duplicates(const vector<Point>& points, int copies_per_point, int every_nth, unsigned seed = 42);
+
+// An index under test, seen only through batched query functions
+struct IndexVariant {
+    string name;
+    function<vector<vector<Point>>(const vector<Rectangle>&)> range;
+    function<vector<vector<pair<Point, float>>>(const vector<Point>&, int)> knn;
+};
+
+// The trees and their execution modes, all built over the same points
+vector<IndexVariant> standard_variants(const vector<Point>& points);
+
+struct VariantReport {
+    string name;
+    size_t range_queries;
+    size_t range_mismatches;
+    size_t knn_queries;
+    size_t knn_mismatches;
+    double range_us;      // μs per range query
+    double knn_us;        // μs per k-NN query
+    double range_speedup; // over the naive scan
+    double knn_speedup;
+};
+
+// Runs every variant on the same queries, checks each answer against the
+// NaiveIndex oracle and times everything, naive baseline first. Each timing is
+// the median of repetitions runs after an untimed warm-up run.
+vector<VariantReport> run_harness(const vector<Point>& points, const vector<IndexVariant>& variants,
+                                  const vector<Rectangle>& ranges, const vector<Point>& knn_queries,
+                                  const vector<int>& ks, ostream* log = nullptr, int repetitions = 3);
+
+void print_report(ostream& os, const vector<VariantReport>& reports);
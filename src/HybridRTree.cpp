@@ -0,0 +1,222 @@
+#include "HybridRTree.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+using namespace std;
+
+HybridRTree::HybridRTree(int min_entries, int max_entries, SortMethod method,
+                         size_t merge_threshold, chrono::milliseconds merge_interval)
+    : min_entries(min_entries), max_entries(max_entries), method(method),
+      merge_threshold(merge_threshold), merge_interval(merge_interval),
+      base(build({})), delta(make_shared<const Buffer>()), merging(make_shared<const Buffer>()),
+      tombstones(make_shared<const Tombstones>()), epoch(0), stopping(false) {
+    merger = thread(&HybridRTree::background_loop, this);
+}
+
+HybridRTree::~HybridRTree() {
+    {
+        lock_guard<mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    merger.join();
+}
+
+shared_ptr<const RTree> HybridRTree::build(const vector<Point>& points) const {
+    auto tree = make_shared<RTree>(Rectangle(0, 0, 0, 0), min_entries, max_entries);
+    tree->insert(points, method);
+    return tree;
+}
+
+// The write buffers are kept sorted by x, so queries only look at the slab of
+// buffered points whose x can still match
+static bool x_less(const Point& a, const Point& b) {
+    return a.x < b.x;
+}
+
+static vector<Point>::const_iterator first_at_or_after(const vector<Point>& buffer, float x) {
+    return lower_bound(buffer.begin(), buffer.end(), x, [](const Point& p, float value) { return p.x < value; });
+}
+
+void HybridRTree::bulk_load(const vector<Point>& points) {
+    lock_guard<mutex> merge_lock(merge_mutex);
+    shared_ptr<const RTree> fresh = build(points);
+
+    lock_guard<mutex> lock(state_mutex);
+    base = fresh;
+    delta = make_shared<const Buffer>();
+    merging = make_shared<const Buffer>();
+    tombstones = make_shared<const Tombstones>();
+}
+
+void HybridRTree::insert(const Point& point) {
+    lock_guard<mutex> lock(state_mutex);
+    auto updated = make_shared<Buffer>();
+    updated->reserve(delta->size() + 1);
+    auto at = upper_bound(delta->begin(), delta->end(), point, x_less);
+    updated->insert(updated->end(), delta->begin(), at);
+    updated->push_back(point);
+    updated->insert(updated->end(), at, delta->end());
+    delta = move(updated);
+}
+
+// Copy of buffer without id, or buffer itself when id is not in it
+static shared_ptr<const vector<Point>> without_id(const shared_ptr<const vector<Point>>& buffer, int id) {
+    auto same_id = [id](const Point& p) { return p.id == id; };
+    if (none_of(buffer->begin(), buffer->end(), same_id)) return buffer;
+
+    auto updated = make_shared<vector<Point>>();
+    updated->reserve(buffer->size());
+    remove_copy_if(buffer->begin(), buffer->end(), back_inserter(*updated), same_id);
+    return updated;
+}
+
+void HybridRTree::remove(int id) {
+    lock_guard<mutex> lock(state_mutex);
+    delta = without_id(delta, id);
+    merging = without_id(merging, id);
+    auto updated = make_shared<Tombstones>(*tombstones);
+    (*updated)[id] = epoch;
+    tombstones = move(updated);
+}
+
+size_t HybridRTree::delta_size() const {
+    lock_guard<mutex> lock(state_mutex);
+    return delta->size() + merging->size();
+}
+
+HybridRTree::Snapshot HybridRTree::snapshot() const {
+    lock_guard<mutex> lock(state_mutex);
+    return Snapshot{base, delta, merging, tombstones};
+}
+
+// Everything runs on a snapshot without holding the lock. It pairs a base with
+// the buffers and tombstones that belong to it, so a merge swapping in a new
+// base meanwhile does not affect the answer.
+vector<Point> HybridRTree::range_query(const Rectangle& range_rect) const {
+    Snapshot state = snapshot();
+    vector<Point> found = state.base->range_query(range_rect);
+
+    const Tombstones& removed = *state.tombstones;
+    if (!removed.empty()) {
+        found.erase(remove_if(found.begin(), found.end(),
+                              [&removed](const Point& p) { return removed.count(p.id) > 0; }),
+                    found.end());
+    }
+    for (const Buffer* buffer : {state.merging.get(), state.delta.get()}) {
+        for (auto it = first_at_or_after(*buffer, range_rect.left); it != buffer->end() && it->x <= range_rect.right; ++it) {
+            if (range_rect.contains(*it)) {
+                found.push_back(*it);
+            }
+        }
+    }
+    return found;
+}
+
+vector<pair<Point, float>> HybridRTree::knn_query(const Point& query, int k) const {
+    Snapshot state = snapshot();
+    const Tombstones& removed = *state.tombstones;
+    auto by_distance = [](const pair<Point, float>& a, const pair<Point, float>& b) { return a.second < b.second; };
+
+    // Ask the base for more neighbors until enough survive the tombstones
+    size_t limit = max(k, 0);
+    vector<pair<Point, float>> base_results;
+    for (int want = k;; want *= 2) {
+        base_results = state.base->knn_query(query, want);
+        bool exhausted = base_results.size() < static_cast<size_t>(want);
+        if (!removed.empty()) {
+            base_results.erase(remove_if(base_results.begin(), base_results.end(),
+                                         [&removed](const pair<Point, float>& entry) { return removed.count(entry.first.id) > 0; }),
+                               base_results.end());
+        }
+        if (base_results.size() >= limit || exhausted) break;
+    }
+
+    // The base results come sorted, so once there are k of them a buffered
+    // point further than the k-th, in x alone or at all, cannot make it in
+    float reach = base_results.size() >= limit && limit > 0 ? base_results[limit - 1].second : numeric_limits<float>::infinity();
+    vector<pair<Point, float>> buffered;
+    auto offer = [&](const Point& p) {
+        float dist = query.distance_to_point(p);
+        if (dist <= reach) buffered.emplace_back(p, dist);
+    };
+    for (const Buffer* buffer : {state.merging.get(), state.delta.get()}) {
+        auto middle = first_at_or_after(*buffer, query.x);
+        for (auto it = middle; it != buffer->end() && it->x - query.x <= reach; ++it) {
+            offer(*it);
+        }
+        for (auto it = middle; it != buffer->begin() && query.x - prev(it)->x <= reach; --it) {
+            offer(*prev(it));
+        }
+    }
+    sort(buffered.begin(), buffered.end(), by_distance);
+
+    // Both lists are sorted, so the k nearest are a merge of their fronts
+    vector<pair<Point, float>> results;
+    results.reserve(min(limit, base_results.size() + buffered.size()));
+    auto from_base = base_results.begin(), from_buffer = buffered.begin();
+    while (results.size() < limit && (from_base != base_results.end() || from_buffer != buffered.end())) {
+        if (from_buffer == buffered.end() || (from_base != base_results.end() && !by_distance(*from_buffer, *from_base))) {
+            results.push_back(*from_base++);
+        } else {
+            results.push_back(*from_buffer++);
+        }
+    }
+    return results;
+}
+
+// Folds the delta and the tombstones recorded so far into a freshly packed base.
+// Writes that arrive while the new tree is built go to a new delta / a newer
+// epoch and survive the swap.
+void HybridRTree::merge() {
+    lock_guard<mutex> merge_lock(merge_mutex);
+
+    Snapshot state;
+    size_t merge_epoch;
+    {
+        lock_guard<mutex> lock(state_mutex);
+        if (delta->empty() && tombstones->empty()) return;
+
+        merging = delta;
+        delta = make_shared<const Buffer>();
+        state = Snapshot{base, delta, merging, tombstones};
+        merge_epoch = epoch++;
+    }
+
+    vector<Point> points;
+    state.base->collect_points(points);
+    const Tombstones& removed = *state.tombstones;
+    if (!removed.empty()) {
+        points.erase(remove_if(points.begin(), points.end(),
+                               [&removed](const Point& p) { return removed.count(p.id) > 0; }),
+                     points.end());
+    }
+    points.insert(points.end(), state.merging->begin(), state.merging->end());
+    shared_ptr<const RTree> fresh = build(points);
+
+    lock_guard<mutex> lock(state_mutex);
+    base = fresh;
+    merging = make_shared<const Buffer>();
+    auto kept = make_shared<Tombstones>();
+    for (const auto& [id, removed_at] : *tombstones) {
+        if (removed_at > merge_epoch) kept->emplace(id, removed_at);
+    }
+    tombstones = move(kept);
+}
+
+void HybridRTree::background_loop() {
+    unique_lock<mutex> stop_lock(stop_mutex);
+    while (!stop_cv.wait_for(stop_lock, merge_interval, [this] { return stopping; })) {
+        bool due;
+        {
+            lock_guard<mutex> lock(state_mutex);
+            due = delta->size() >= merge_threshold || tombstones->size() >= merge_threshold;
+        }
+        if (due) {
+            stop_lock.unlock();
+            merge();
+            stop_lock.lock();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include "RTree.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <chrono>
+
+using namespace std;
+
+// LSM-style wrapper around a packed RTree. Inserts go to an x-sorted delta
+// buffer and deletes to a tombstone set (which hides matching ids in the packed
+// base), so writes never touch the tree. Queries merge base and delta. A
+// background thread periodically re-packs base + delta with RTree::insert and
+// swaps the new tree in under a short lock. Base, buffers and tombstones are
+// immutable once published (writers replace them with modified copies), so a
+// query only holds the lock to take a consistent snapshot and reads it without
+// blocking anyone. Point ids are expected to be unique; re-inserting an id
+// after remove is fine.
+class HybridRTree {
+public:
+    HybridRTree(int min_entries, int max_entries, SortMethod method,
+                size_t merge_threshold = 4096,
+                chrono::milliseconds merge_interval = chrono::milliseconds(100));
+    ~HybridRTree();
+
+    HybridRTree(const HybridRTree&) = delete;
+    HybridRTree& operator=(const HybridRTree&) = delete;
+
+    void bulk_load(const vector<Point>& points);
+    void insert(const Point& point);
+    void remove(int id);
+
+    vector<Point> range_query(const Rectangle& range_rect) const;
+    vector<pair<Point, float>> knn_query(const Point& query, int k) const;
+
+    void merge();               // re-pack now, on the calling thread
+    size_t delta_size() const;  // buffered inserts not yet in the base
+
+private:
+    int min_entries;
+    int max_entries;
+    SortMethod method;
+    size_t merge_threshold;
+    chrono::milliseconds merge_interval;
+
+    using Buffer = vector<Point>;
+    using Tombstones = unordered_map<int, size_t>;
+
+    // What a query reads, taken together under state_mutex
+    struct Snapshot {
+        shared_ptr<const RTree> base;
+        shared_ptr<const Buffer> delta;
+        shared_ptr<const Buffer> merging;
+        shared_ptr<const Tombstones> tombstones;
+    };
+
+    mutable mutex state_mutex;
+    shared_ptr<const RTree> base;
+    shared_ptr<const Buffer> delta;           // inserts since the last merge started, sorted by x
+    shared_ptr<const Buffer> merging;         // inserts being folded into the next base, sorted by x
+    shared_ptr<const Tombstones> tombstones;  // id -> epoch of the remove; hides ids in base
+    size_t epoch;                             // bumped when a merge starts
+
+    mutex merge_mutex;                        // one merge at a time
+    mutex stop_mutex;
+    condition_variable stop_cv;
+    bool stopping;
+    thread merger;
+
+    Snapshot snapshot() const;
+    shared_ptr<const RTree> build(const vector<Point>& points) const;
+    void background_loop();
+};
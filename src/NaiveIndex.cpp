@@ -0,0 +1,139 @@
+#include "NaiveIndex.h"
+#include <algorithm>
+#include <queue>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+NaiveIndex::NaiveIndex(const vector<Point>& points) {
+    ids.reserve(points.size());
+    xs.reserve(points.size());
+    ys.reserve(points.size());
+    for (const Point& p : points) {
+        ids.push_back(p.id);
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+}
+
+size_t NaiveIndex::size() const {
+    return ids.size();
+}
+
+Point NaiveIndex::point_at(size_t i) const {
+    return Point(ids[i], xs[i], ys[i]);
+}
+
+// Same comparisons as Rectangle::contains, so results match the trees exactly
+vector<Point> NaiveIndex::range_query(const Rectangle& range_rect) const {
+    vector<Point> found;
+    size_t n = size();
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256 left = _mm256_set1_ps(range_rect.left), right = _mm256_set1_ps(range_rect.right);
+    __m256 bottom = _mm256_set1_ps(range_rect.bottom), top = _mm256_set1_ps(range_rect.top);
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&xs[i]);
+        __m256 y = _mm256_loadu_ps(&ys[i]);
+        __m256 in = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(left, x, _CMP_LE_OQ), _mm256_cmp_ps(x, right, _CMP_LE_OQ)),
+                                  _mm256_and_ps(_mm256_cmp_ps(bottom, y, _CMP_LE_OQ), _mm256_cmp_ps(y, top, _CMP_LE_OQ)));
+        int mask = _mm256_movemask_ps(in);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            found.push_back(point_at(i + bit));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    __m128 left = _mm_set1_ps(range_rect.left), right = _mm_set1_ps(range_rect.right);
+    __m128 bottom = _mm_set1_ps(range_rect.bottom), top = _mm_set1_ps(range_rect.top);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(&xs[i]);
+        __m128 y = _mm_loadu_ps(&ys[i]);
+        __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(left, x), _mm_cmple_ps(x, right)),
+                               _mm_and_ps(_mm_cmple_ps(bottom, y), _mm_cmple_ps(y, top)));
+        int mask = _mm_movemask_ps(in);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            found.push_back(point_at(i + bit));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < n; ++i) {
+        if (range_rect.left <= xs[i] && xs[i] <= range_rect.right &&
+            range_rect.bottom <= ys[i] && ys[i] <= range_rect.top) {
+            found.push_back(point_at(i));
+        }
+    }
+    return found;
+}
+
+// Keeps the k best squared distances in a max-heap. Whole blocks whose
+// distances are all above the current k-th best are skipped with one compare.
+vector<pair<Point, float>> NaiveIndex::knn_query(const Point& query, int k) const {
+    vector<pair<Point, float>> results;
+    if (k <= 0) return results;
+
+    priority_queue<pair<float, size_t>> best;
+    auto consider = [&](float d2, size_t i) {
+        if (best.size() < static_cast<size_t>(k)) {
+            best.emplace(d2, i);
+        } else if (d2 < best.top().first) {
+            best.pop();
+            best.emplace(d2, i);
+        }
+    };
+
+    size_t n = size();
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256 qx = _mm256_set1_ps(query.x), qy = _mm256_set1_ps(query.y);
+    alignas(32) float d2[8];
+    for (; i + 8 <= n; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&xs[i]), qx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&ys[i]), qy);
+        __m256 dist = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        if (best.size() == static_cast<size_t>(k) &&
+            _mm256_movemask_ps(_mm256_cmp_ps(dist, _mm256_set1_ps(best.top().first), _CMP_LT_OQ)) == 0) {
+            continue;
+        }
+        _mm256_store_ps(d2, dist);
+        for (int j = 0; j < 8; ++j) consider(d2[j], i + j);
+    }
+#elif defined(__SSE2__)
+    __m128 qx = _mm_set1_ps(query.x), qy = _mm_set1_ps(query.y);
+    alignas(16) float d2[4];
+    for (; i + 4 <= n; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&xs[i]), qx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&ys[i]), qy);
+        __m128 dist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        if (best.size() == static_cast<size_t>(k) &&
+            _mm_movemask_ps(_mm_cmplt_ps(dist, _mm_set1_ps(best.top().first))) == 0) {
+            continue;
+        }
+        _mm_store_ps(d2, dist);
+        for (int j = 0; j < 4; ++j) consider(d2[j], i + j);
+    }
+#endif
+
+    for (; i < n; ++i) {
+        float dx = xs[i] - query.x;
+        float dy = ys[i] - query.y;
+        consider(dx * dx + dy * dy, i);
+    }
+
+    while (!best.empty()) {
+        Point p = point_at(best.top().second);
+        results.emplace_back(p, query.distance_to_point(p));
+        best.pop();
+    }
+    reverse(results.begin(), results.end());
+    return results;
+}
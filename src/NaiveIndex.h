@@ -0,0 +1,23 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include <vector>
+
+using namespace std;
+
+// Brute-force scan over all points, the "Naïve method" baseline. Coordinates
+// are kept as separate arrays so the scans run 8 (AVX2) or 4 (SSE2) points per
+// instruction. Its answers are the ground truth the trees are checked against.
+class NaiveIndex {
+public:
+    vector<int> ids;
+    vector<float> xs;
+    vector<float> ys;
+
+    explicit NaiveIndex(const vector<Point>& points);
+
+    size_t size() const;
+    Point point_at(size_t i) const;
+    vector<Point> range_query(const Rectangle& range_rect) const;
+    vector<pair<Point, float>> knn_query(const Point& query, int k) const;
+};
@@ -24,4 +24,24 @@ float Point::distance_to_rectangle(const Rectangle& rect) const {
     float dx = max({rect.left - x,  0.0f , x - rect.right});
     float dy = max({rect.bottom - y, 0.0f, y - rect.top});
     return sqrt(dx * dx + dy * dy);
+}
+
+float Point::squared_distance_to_point(const Point& point) const {
+    float dx = x - point.x;
+    float dy = y - point.y;
+    return dx*dx + dy*dy;
+}
+
+// MINDIST^2 to the rectangle (0 if the point is inside)
+float Point::squared_distance_to_rectangle(const Rectangle& rect) const {
+    float dx = max({rect.left - x,  0.0f , x - rect.right});
+    float dy = max({rect.bottom - y, 0.0f, y - rect.top});
+    return dx * dx + dy * dy;
+}
+
+// MAXDIST^2: distance to the farthest corner of the rectangle
+float Point::max_squared_distance_to_rectangle(const Rectangle& rect) const {
+    float dx = max(fabs(x - rect.left), fabs(x - rect.right));
+    float dy = max(fabs(y - rect.bottom), fabs(y - rect.top));
+    return dx * dx + dy * dy;
 }
\ No newline at end of file
@@ -14,6 +14,9 @@ public:
 
     float distance_to_point(const Point& point) const;
     float distance_to_rectangle(const Rectangle& rect) const;
+    float squared_distance_to_point(const Point& point) const;
+    float squared_distance_to_rectangle(const Rectangle& rect) const;
+    float max_squared_distance_to_rectangle(const Rectangle& rect) const;
 };
 
 ostream& operator<<(ostream& os, const Point& point);
\ No newline at end of file
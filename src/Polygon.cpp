@@ -0,0 +1,90 @@
+#include "Polygon.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// Liang-Barsky clipping: true if segment a-b touches the (closed) rectangle
+static bool segment_intersects(const Point& a, const Point& b, const Rectangle& rect) {
+    float t0 = 0.0f, t1 = 1.0f;
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {a.x - rect.left, rect.right - a.x, a.y - rect.bottom, rect.top - a.y};
+
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) return false;
+        } else {
+            float t = q[i] / p[i];
+            if (p[i] < 0.0f) t0 = max(t0, t);
+            else t1 = min(t1, t);
+            if (t0 > t1) return false;
+        }
+    }
+    return true;
+}
+
+Polygon::Polygon(const vector<Point>& vertices)
+    : vertices(vertices), bounds(Rectangle::bounding(vertices)) {}
+
+ostream& operator<<(ostream& os, const Polygon& polygon) {
+    os << "Polygon(";
+    for (size_t i = 0; i < polygon.vertices.size(); ++i) {
+        if (i > 0) os << ", ";
+        os << polygon.vertices[i];
+    }
+    os << ")";
+    return os;
+}
+
+// Even-odd ray casting. Points exactly on an edge may fall on either side.
+bool Polygon::contains(const Point& point) const {
+    if (!bounds.contains(point)) return false;
+
+    bool inside = false;
+    size_t n = vertices.size();
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        const Point& a = vertices[i];
+        const Point& b = vertices[j];
+        if ((a.y > point.y) != (b.y > point.y) &&
+            point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+bool Polygon::intersects(const Rectangle& rect) const {
+    if (!bounds.intersects(rect)) return false;
+
+    for (const Point& v : vertices) {
+        if (rect.contains(v)) return true;
+    }
+    if (contains(Point(-1, rect.x, rect.y))) return true;
+
+    size_t n = vertices.size();
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        if (segment_intersects(vertices[j], vertices[i], rect)) return true;
+    }
+    return false;
+}
+
+// Conservative: false negatives only cost a descent into the subtree, while a
+// false positive would return points outside the polygon.
+bool Polygon::contains_rectangle(const Rectangle& rect) const {
+    if (rect.left < bounds.left || rect.right > bounds.right ||
+        rect.bottom < bounds.bottom || rect.top > bounds.top) {
+        return false;
+    }
+
+    for (const Point& corner : {Point(-1, rect.left, rect.bottom), Point(-1, rect.right, rect.bottom),
+                                Point(-1, rect.left, rect.top), Point(-1, rect.right, rect.top)}) {
+        if (!contains(corner)) return false;
+    }
+
+    size_t n = vertices.size();
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        if (segment_intersects(vertices[j], vertices[i], rect)) return false;
+    }
+    return true;
+}
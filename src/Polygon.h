@@ -0,0 +1,21 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+class Polygon {
+public:
+    vector<Point> vertices;
+    Rectangle bounds;
+
+    explicit Polygon(const vector<Point>& vertices);
+
+    bool contains(const Point& point) const;
+    bool intersects(const Rectangle& rect) const;
+    bool contains_rectangle(const Rectangle& rect) const;
+};
+
+ostream& operator<<(ostream& os, const Polygon& polygon);
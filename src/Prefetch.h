@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Prefetches every cache line overlapping [data, data + bytes)
+inline void prefetch_range(const void* data, size_t bytes) {
+    const uintptr_t line = 64;
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(line - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(data) + bytes;
+    for (uintptr_t p = begin; p < end; p += line) {
+        __builtin_prefetch(reinterpret_cast<const void*>(p));
+    }
+}
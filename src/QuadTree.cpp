@@ -1,19 +1,24 @@
 #include "QuadTree.h"
 #include "HeapEntry.h"
+#include "TreeStats.h"
+#include "Prefetch.h"
 #include <queue>
 #include <fstream>
 #include <numeric>
 #include <cmath>   
 #include <functional>
 #include <algorithm>
+#include <climits>
+#include <limits>
 
 
 using namespace std;
 
 
-QuadTree::QuadTree(Rectangle boundary, int capacity)
+QuadTree::QuadTree(Rectangle boundary, int capacity, int max_depth, int depth)
     : boundary(boundary), capacity(capacity), divided(false),
-      northwest(nullptr),  northeast(nullptr), southwest(nullptr), southeast(nullptr) {}
+      northwest(nullptr),  northeast(nullptr), southwest(nullptr), southeast(nullptr),
+      max_depth(max_depth), depth(depth), overflow_ids(nullptr) {}
 
 
 QuadTree::~QuadTree() {
@@ -21,26 +26,63 @@ QuadTree::~QuadTree() {
     delete northeast;
     delete southwest;
     delete southeast;
+    delete overflow_ids;
 }
 
 
-void QuadTree::subdivide() {
+// False at the depth limit, or once the quadrants would be too small to be
+// told apart in float. Such leaves act as overflow buckets, which keeps many
+// points at (nearly) the same coordinates from recursing without bound.
+bool QuadTree::can_subdivide() const {
+    if (max_depth >= 0 && depth >= max_depth)
+        return false;
+
+    float w = boundary.w / 4;
+    float h = boundary.h / 4;
+    return boundary.x - w != boundary.x && boundary.x + w != boundary.x &&
+           boundary.y - h != boundary.y && boundary.y + h != boundary.y;
+}
+
+
+// Quadrants are indexed NW, NE, SW, SE. They share their inner edges with the
+// center lines exactly, so they tile the parent without float gaps.
+Rectangle QuadTree::quadrant_boundary(int index) const {
     float x = boundary.x;
     float y = boundary.y;
-    float w = boundary.w/2;
-    float h = boundary.h/2;
 
-    Rectangle nw(x - w / 2, y + h / 2, w, h);
-    Rectangle ne(x + w / 2, y + h / 2, w, h);
-    Rectangle sw(x - w / 2, y - h / 2, w, h);
-    Rectangle se(x + w / 2, y - h / 2, w, h);
+    float left = (index == 0 || index == 2) ? boundary.left : x;
+    float right = (index == 0 || index == 2) ? x : boundary.right;
+    float bottom = (index == 0 || index == 1) ? y : boundary.bottom;
+    float top = (index == 0 || index == 1) ? boundary.top : y;
+    return Rectangle::from_bounds(left, bottom, right, top);
+}
+
+
+// Picks the quadrant for a point directly from the center lines (points on them
+// go north/east, as when NE was tried first), creating it on first use so empty
+// quadrants are never allocated.
+QuadTree* QuadTree::child_for(const Point& point) {
+    int chosen = (point.y >= boundary.y ? 0 : 2) + (point.x >= boundary.x ? 1 : 0);
+    QuadTree** quadrants[4] = {&northwest, &northeast, &southwest, &southeast};
 
-    northwest = new QuadTree(nw, capacity);
-    northeast = new QuadTree(ne, capacity);
-    southwest = new QuadTree(sw, capacity);
-    southeast = new QuadTree(se, capacity);
+    QuadTree*& child = *quadrants[chosen];
+    if (!child) {
+        child = new QuadTree(quadrant_boundary(chosen), capacity, max_depth, depth + 1);
+    }
+    return child;
+}
 
+
+void QuadTree::subdivide() {
     divided = true;
+
+    // Children start empty and the parent held at most capacity points, so they
+    // can be handed down without further splitting or duplicate checks
+    for (const Point& p : points) {
+        child_for(p)->points.push_back(p);
+    }
+    points.clear();
+    points.shrink_to_fit();
 }
 
 
@@ -48,36 +90,46 @@ bool QuadTree::insert(const Point& point) {
     if (!boundary.contains(point))
         return false;
 
-    if (!divided && points.size() < capacity) {
-        for (const Point& p : points) {
+    QuadTree* node = this;
+    while (true) {
+        if (node->divided) {
+            node = node->child_for(point);
+            continue;
+        }
+
+        // Overflow buckets grow past capacity, so they look ids up in a set
+        // instead of scanning, which would make filling one quadratic
+        if (node->overflow_ids) {
+            if (!node->overflow_ids->insert(point.id).second)
+                return false;
+            node->points.push_back(point);
+            return true;
+        }
+
+        for (const Point& p : node->points) {
             if (p.id == point.id) { 
                 return false;
             }
         }
-        points.push_back(point);
-        return true;
-    }
 
-    if (!divided) {
-        subdivide();
-
-        for (const Point& p : points) {
-            for (QuadTree* quadrant : {northeast, northwest, southeast, southwest}) {
-                if (quadrant->insert(p)) {
-                    break;
-                }
-            }
+        size_t capacity_limit = max(node->capacity, 0);
+        if (node->points.size() < capacity_limit) {
+            node->points.push_back(point);
+            return true;
         }
-        points.clear();
-    }
 
-    for (QuadTree* quadrant : {northeast, northwest, southeast, southwest}) {
-        if (quadrant->insert(point)) {
+        if (!node->can_subdivide()) {
+            node->overflow_ids = new unordered_set<int>();
+            for (const Point& p : node->points) {
+                node->overflow_ids->insert(p.id);
+            }
+            node->overflow_ids->insert(point.id);
+            node->points.push_back(point);
             return true;
         }
-    }
 
-    return false;
+        node->subdivide();
+    }
 }
 
 vector<Point> QuadTree::range_query(const Rectangle& range_rect) const {
@@ -88,6 +140,7 @@ vector<Point> QuadTree::range_query(const Rectangle& range_rect) const {
 
     if (divided) {
         for (QuadTree* quadrant : {northwest, northeast, southwest, southeast}) {
+            if (!quadrant) continue;
             vector<Point> subfound = quadrant->range_query(range_rect);
             found.insert(found.end(), subfound.begin(), subfound.end());
         }
@@ -104,14 +157,104 @@ vector<Point> QuadTree::range_query(const Rectangle& range_rect) const {
 }
 
 
-vector<pair<Point, float>> QuadTree::knn_query(const Point& query, int k) const {
+// Appends every point stored in this subtree to out
+void QuadTree::collect_points(vector<Point>& out) const {
+    vector<const QuadTree*> stack{this};
+    while (!stack.empty()) {
+        const QuadTree* node = stack.back();
+        stack.pop_back();
+
+        if (!node->divided) {
+            out.insert(out.end(), node->points.begin(), node->points.end());
+        }
+        else {
+            for (QuadTree* child : {node->southeast, node->southwest, node->northeast, node->northwest}) {
+                if (child) stack.push_back(child);
+            }
+        }
+    }
+}
+
+// Points inside an arbitrary simple polygon. Subtrees whose MBR lies entirely
+// inside the polygon are taken wholesale, disjoint ones are pruned.
+vector<Point> QuadTree::range_query(const Polygon& polygon) const {
+    vector<Point> found;
+    vector<const QuadTree*> stack{this};
+
+    while (!stack.empty()) {
+        const QuadTree* node = stack.back();
+        stack.pop_back();
+
+        if (!polygon.intersects(node->boundary))
+            continue;
+
+        if (polygon.contains_rectangle(node->boundary)) {
+            node->collect_points(found);
+        }
+        else if (!node->divided) {
+            for (const Point& p : node->points) {
+                if (polygon.contains(p)) {
+                    found.push_back(p);
+                }
+            }
+        }
+        else {
+            for (QuadTree* child : {node->southeast, node->southwest, node->northeast, node->northwest}) {
+                if (child) stack.push_back(child);
+            }
+        }
+    }
+
+    return found;
+}
+
+// All points within radius of center. MINDIST prunes subtrees, MAXDIST accepts
+// them wholesale; everything is compared squared so no sqrt is taken.
+vector<Point> QuadTree::within_distance(const Point& center, float radius) const {
+    vector<Point> found;
+    if (radius < 0) return found;
+
+    float radius_sq = radius * radius;
+    vector<const QuadTree*> stack{this};
+
+    while (!stack.empty()) {
+        const QuadTree* node = stack.back();
+        stack.pop_back();
+
+        if (center.squared_distance_to_rectangle(node->boundary) > radius_sq)
+            continue;
+
+        if (center.max_squared_distance_to_rectangle(node->boundary) <= radius_sq) {
+            node->collect_points(found);
+        }
+        else if (!node->divided) {
+            for (const Point& p : node->points) {
+                if (center.squared_distance_to_point(p) <= radius_sq) {
+                    found.push_back(p);
+                }
+            }
+        }
+        else {
+            for (QuadTree* child : {node->southeast, node->southwest, node->northeast, node->northwest}) {
+                if (child) stack.push_back(child);
+            }
+        }
+    }
+
+    return found;
+}
+
+vector<pair<Point, float>> QuadTree::knn_query(const Point& query, int k, float slack) const {
     priority_queue<HeapEntry<QuadTree>> heap;
     vector<pair<Point, float>> results;
     int counter = 0;
+    size_t limit = max(k, 0);
 
     heap.emplace(query.distance_to_rectangle(boundary), counter++, this);
 
-    while (!heap.empty() && results.size() < k) {
+    // Past k results, keep popping points within slack of the k-th distance
+    while (!heap.empty() && (results.size() < limit ||
+           (slack > 0 && limit > 0 && heap.top().dist <= results[limit - 1].second + slack))) {
         HeapEntry<QuadTree> entry = heap.top();
         heap.pop();
 
@@ -143,6 +286,278 @@ vector<pair<Point, float>> QuadTree::knn_query(const Point& query, int k) const
 }
 
 
+// Approximate k-NN. A node is pruned once its MINDIST * (1 + epsilon) exceeds
+// the k-th best point distance seen so far, so every returned neighbor is within
+// a factor (1 + epsilon) of the true one. max_visited_nodes / max_visited_leaves
+// (0 = unlimited) additionally cap the work done per query. exact reports whether
+// any pruned or capped node could have held a closer point.
+ApproxKnnResult QuadTree::knn_query_approx(const Point& query, int k, float epsilon, int max_visited_nodes, int max_visited_leaves) const {
+    priority_queue<HeapEntry<QuadTree>> heap;
+    priority_queue<float> best; // max-heap of the k smallest point distances seen
+    ApproxKnnResult result{{}, true, 0, 0};
+    int counter = 0;
+    size_t limit = max(k, 0);
+
+    heap.emplace(query.distance_to_rectangle(boundary), counter++, this);
+
+    while (!heap.empty() && result.neighbors.size() < limit) {
+        HeapEntry<QuadTree> entry = heap.top();
+        heap.pop();
+
+        if (holds_alternative<Point>(entry.data)) {
+            result.neighbors.emplace_back(get<Point>(entry.data), entry.dist);
+            continue;
+        }
+
+        const QuadTree* node = get<const QuadTree*>(entry.data);
+        float kth = best.size() < limit ? numeric_limits<float>::infinity() : best.top();
+        bool leaf = !node->divided;
+
+        bool over_budget = (max_visited_nodes > 0 && result.visited_nodes >= max_visited_nodes) ||
+                           (leaf && max_visited_leaves > 0 && result.visited_leaves >= max_visited_leaves);
+        if (over_budget || entry.dist * (1.0f + epsilon) > kth) {
+            if (entry.dist < kth) result.exact = false;
+            continue;
+        }
+
+        result.visited_nodes++;
+        if (leaf) {
+            result.visited_leaves++;
+            for (const Point& p : node->points) {
+                float dist = query.distance_to_point(p);
+                if (best.size() < limit) {
+                    best.push(dist);
+                }
+                else if (dist < best.top()) {
+                    best.pop();
+                    best.push(dist);
+                }
+                else if (dist > best.top()) {
+                    continue; // can never make it into the result
+                }
+                heap.emplace(dist, counter++, p);
+            }
+        }
+        else {
+            for (QuadTree* child : {node->northwest, node->northeast, node->southwest, node->southeast}) {
+                if (child) {
+                    heap.emplace(query.distance_to_rectangle(child->boundary), counter++, child);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Batched range queries, software-pipelined over up to group_size queries.
+// Each query is a small state machine that only reads memory prefetched at
+// least one turn earlier:
+//   FETCH:   pop nodes (prefetched when they were pushed), drop those outside
+//            the range and push the quadrants of internal ones, prefetching
+//            them; stop at the first leaf that intersects and prefetch its points
+//   PAYLOAD: scan the leaf's points
+// Every other in-flight query takes a turn in between, so each prefetch has a
+// full round to arrive and the misses of different queries overlap.
+vector<vector<Point>> QuadTree::range_query_batch(const vector<Rectangle>& ranges, int group_size) const {
+    enum Stage { FETCH, PAYLOAD };
+    struct Slot {
+        size_t query;
+        vector<const QuadTree*> stack;
+        const QuadTree* node;
+        Stage stage;
+        bool done;
+    };
+
+    vector<vector<Point>> results(ranges.size());
+    size_t group = min(static_cast<size_t>(max(group_size, 1)), ranges.size());
+    vector<Slot> slots(group);
+    size_t next_query = 0;
+    size_t active = group;
+
+    auto start = [&](Slot& slot) {
+        slot.query = next_query++;
+        slot.stack.assign(1, this);
+        slot.node = nullptr;
+        slot.stage = FETCH;
+        slot.done = false;
+    };
+    for (Slot& slot : slots) start(slot);
+
+    while (active > 0) {
+        for (Slot& slot : slots) {
+            if (slot.done) continue;
+
+            const Rectangle& range_rect = ranges[slot.query];
+
+            if (slot.stage == FETCH) {
+                slot.node = nullptr;
+                while (!slot.stack.empty()) {
+                    const QuadTree* candidate = slot.stack.back();
+                    slot.stack.pop_back();
+                    if (!candidate->boundary.intersects(range_rect))
+                        continue;
+
+                    if (!candidate->divided) {
+                        slot.node = candidate;
+                        break;
+                    }
+                    // Push in reverse so results come out in the same order as range_query
+                    for (QuadTree* child : {candidate->southeast, candidate->southwest, candidate->northeast, candidate->northwest}) {
+                        if (child) {
+                            __builtin_prefetch(child);
+                            slot.stack.push_back(child);
+                        }
+                    }
+                    // The quadrants were only just prefetched, give them a round
+                    break;
+                }
+
+                if (slot.node) {
+                    prefetch_range(slot.node->points.data(), slot.node->points.size() * sizeof(Point));
+                    slot.stage = PAYLOAD;
+                } else if (slot.stack.empty()) {
+                    if (next_query < ranges.size()) {
+                        start(slot);
+                    } else {
+                        slot.done = true;
+                        active--;
+                    }
+                }
+            }
+            else {
+                for (const Point& p : slot.node->points) {
+                    if (range_rect.contains(p)) {
+                        results[slot.query].push_back(p);
+                    }
+                }
+                slot.stage = FETCH;
+            }
+        }
+    }
+
+    return results;
+}
+
+// Batched k-NN queries, pipelined like range_query_batch. Each slot keeps only
+// nodes in its traversal heap; points go to an unsorted candidate buffer that
+// is cut back to the k nearest (nth_element) whenever it reaches 2k. The k-th
+// distance of the last cut bounds the search, so points and nodes beyond it
+// are dropped right away:
+//   FETCH:    pop the nearest node (prefetched when its parent was expanded)
+//             unless it is no closer than the bound, which ends the query;
+//             prefetch a leaf's points or the quadrants of an internal node
+//   PAYLOAD:  offer the leaf's points to the candidates
+//   CHILDREN: push the quadrants closer than the bound
+// Points tied with the k-th distance may be chosen differently than by
+// knn_query; the distances returned are the same.
+vector<vector<pair<Point, float>>> QuadTree::knn_query_batch(const vector<Point>& queries, int k, int group_size) const {
+    enum Stage { FETCH, PAYLOAD, CHILDREN };
+    typedef pair<float, const QuadTree*> NodeEntry;
+    struct Slot {
+        size_t query;
+        vector<NodeEntry> nodes;          // min-heap on MINDIST, reused across the slot's queries
+        vector<pair<Point, float>> best;  // candidates, at most 2k
+        float bound;                      // k-th distance at the last cut
+        const QuadTree* node;
+        Stage stage;
+        bool done;
+    };
+
+    vector<vector<pair<Point, float>>> results(queries.size());
+    size_t limit = max(k, 0);
+    size_t group = min(static_cast<size_t>(max(group_size, 1)), queries.size());
+    vector<Slot> slots(group);
+    size_t next_query = 0;
+    size_t active = group;
+
+    auto nearer = [](const pair<Point, float>& a, const pair<Point, float>& b) { return a.second < b.second; };
+    auto cut = [&](Slot& slot) {
+        nth_element(slot.best.begin(), slot.best.begin() + (limit - 1), slot.best.end(), nearer);
+        slot.best.erase(slot.best.begin() + limit, slot.best.end());
+        slot.bound = slot.best.back().second;
+    };
+    auto offer = [&](Slot& slot, float dist, const Point& p) {
+        if (dist < slot.bound) {
+            slot.best.emplace_back(p, dist);
+            if (slot.best.size() >= 2 * limit) cut(slot);
+        }
+    };
+    auto push = [](Slot& slot, float dist, const QuadTree* node) {
+        slot.nodes.emplace_back(dist, node);
+        push_heap(slot.nodes.begin(), slot.nodes.end(), greater<NodeEntry>());
+    };
+    auto start = [&](Slot& slot) {
+        slot.query = next_query++;
+        slot.nodes.clear();
+        slot.best.clear();
+        slot.bound = numeric_limits<float>::infinity();
+        slot.node = nullptr;
+        slot.stage = FETCH;
+        slot.done = false;
+        if (limit > 0) push(slot, queries[slot.query].distance_to_rectangle(boundary), this);
+    };
+    for (Slot& slot : slots) start(slot);
+
+    while (active > 0) {
+        for (Slot& slot : slots) {
+            if (slot.done) continue;
+
+            const Point& query = queries[slot.query];
+            const QuadTree* node = slot.node;
+
+            switch (slot.stage) {
+                case FETCH:
+                    if (slot.nodes.empty() || slot.nodes.front().first >= slot.bound) {
+                        if (slot.best.size() > limit) cut(slot);
+                        sort(slot.best.begin(), slot.best.end(), nearer);
+                        results[slot.query] = move(slot.best);
+                        slot.best = vector<pair<Point, float>>();
+                        if (next_query < queries.size()) {
+                            start(slot);
+                        } else {
+                            slot.done = true;
+                            active--;
+                        }
+                        break;
+                    }
+                    node = slot.node = slot.nodes.front().second;
+                    pop_heap(slot.nodes.begin(), slot.nodes.end(), greater<NodeEntry>());
+                    slot.nodes.pop_back();
+                    if (!node->divided) {
+                        prefetch_range(node->points.data(), node->points.size() * sizeof(Point));
+                        slot.stage = PAYLOAD;
+                    } else {
+                        for (QuadTree* child : {node->northwest, node->northeast, node->southwest, node->southeast}) {
+                            if (child) __builtin_prefetch(child);
+                        }
+                        slot.stage = CHILDREN;
+                    }
+                    break;
+
+                case PAYLOAD:
+                    for (const Point& p : node->points) {
+                        offer(slot, query.distance_to_point(p), p);
+                    }
+                    slot.stage = FETCH;
+                    break;
+
+                case CHILDREN:
+                    for (QuadTree* child : {node->northwest, node->northeast, node->southwest, node->southeast}) {
+                        if (child) {
+                            float dist = query.distance_to_rectangle(child->boundary);
+                            if (dist < slot.bound) push(slot, dist, child);
+                        }
+                    }
+                    slot.stage = FETCH;
+                    break;
+            }
+        }
+    }
+
+    return results;
+}
+
 void QuadTree::print_tree(int depth, const std::string& quadrant) const {
     string indent(depth * 2, ' '); // 2 spaces per level
 
@@ -176,45 +591,8 @@ void QuadTree::save_structure(std::ofstream& out) const {
 
 
 QuadTreeStats QuadTree::collect_stats() const {
-    int min_depth = INT_MAX;
-    int max_depth = 0;
-    vector<int> leaf_sizes;
-    int internal_nodes = 0;
-
-    function<void(const QuadTree*, int)> dfs = [&](const QuadTree* node, int depth) {
-        if (!node->divided) {
-            min_depth = min(min_depth, depth);
-            max_depth = max(max_depth, depth);
-            leaf_sizes.push_back(node->points.size());
-        } else {
-            internal_nodes++;
-            for (QuadTree* child : {node->northwest, node->northeast, node->southwest, node->southeast}) {
-                if (child) dfs(child, depth + 1);
-            }
-        }
-    };
-
-    dfs(this, 0);
-
-    int total_leaves = leaf_sizes.size();
-    int total_points = accumulate(leaf_sizes.begin(), leaf_sizes.end(), 0);
-    float avg_points = total_leaves > 0 ? static_cast<float>(total_points) / total_leaves : 0.0f;
-
-    float sum_sq_diff = 0.0f;
-    for (int n : leaf_sizes) {
-        float diff = n - avg_points;
-        sum_sq_diff += diff * diff;
-    }
-    float stddev = total_leaves > 1 ? sqrt(sum_sq_diff / (total_leaves - 1)) : 0.0f;
-
-    sort(leaf_sizes.begin(), leaf_sizes.end());
-    float q1 = 0.0f, q3 = 0.0f;
-    if (!leaf_sizes.empty()) {
-        int mid = total_leaves / 2;
-        q1 = leaf_sizes[mid / 2];
-        q3 = leaf_sizes[(mid + total_leaves) / 2];
-    }
-
-    return QuadTreeStats{max_depth, min_depth, avg_points, stddev,
-                         total_leaves, internal_nodes, total_points, q1, q3};
+    TreeStats stats = compute_stats(*this);
+    return QuadTreeStats{stats.max_depth, stats.min_depth, stats.avg_points_per_leaf, stats.stddev_points_per_leaf,
+                         stats.total_leaves, stats.internal_nodes, stats.total_points,
+                         stats.q1_points_per_leaf, stats.q3_points_per_leaf};
 }
\ No newline at end of file
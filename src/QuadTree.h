@@ -1,5 +1,9 @@
+#pragma once
 #include "Point.h"
 #include "Rectangle.h"
+#include "ApproxKnn.h"
+#include "Polygon.h"
+#include <unordered_set>
 #include <vector>
 
 using namespace std;
@@ -26,16 +30,30 @@ public:
     QuadTree* northeast;
     QuadTree* southwest;
     QuadTree* southeast;
+    int max_depth;  // leaves at this depth keep overflowing instead of splitting, -1 = unbounded
+    int depth;
+    unordered_set<int>* overflow_ids;  // ids in an overflow bucket, so its duplicate check stays O(1)
 
-    QuadTree(Rectangle boundary, int capacity);
+    QuadTree(Rectangle boundary, int capacity, int max_depth = -1, int depth = 0);
     ~QuadTree();
 
+    // Rejects a point whose id is already stored in the leaf it lands in
     bool insert(const Point& point);
     void subdivide(); 
+    bool can_subdivide() const;
+    Rectangle quadrant_boundary(int index) const;
+    QuadTree* child_for(const Point& point);
     void print_tree(int depth = 0, const std::string& quadrant = "ROOT") const;
     void save_structure(std::ofstream& out) const;
     QuadTreeStats collect_stats() const;
     vector<Point> range_query(const Rectangle& range_rect) const;
-    vector<pair<Point, float>> knn_query(const Point& query, int k) const;
+    vector<Point> range_query(const Polygon& polygon) const;
+    vector<Point> within_distance(const Point& center, float radius) const;
+    void collect_points(vector<Point>& out) const;
+    // With slack > 0, points up to the k-th distance + slack are returned as well
+    vector<pair<Point, float>> knn_query(const Point& query, int k, float slack = 0.0f) const;
+    ApproxKnnResult knn_query_approx(const Point& query, int k, float epsilon, int max_visited_nodes = 0, int max_visited_leaves = 0) const;
+    vector<vector<Point>> range_query_batch(const vector<Rectangle>& ranges, int group_size = 16) const;
+    vector<vector<pair<Point, float>>> knn_query_batch(const vector<Point>& queries, int k, int group_size = 16) const;
 };
 
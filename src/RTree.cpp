@@ -1,5 +1,7 @@
 #include "RTree.h"
 #include "HeapEntry.h"
+#include "TreeStats.h"
+#include "Prefetch.h"
 #include <algorithm>
 #include <queue>
 #include <iostream>
@@ -27,16 +29,7 @@ RTree::~RTree() {
 }
 
 Rectangle compute_boundary(const vector<Point>& points) {
-    if (points.empty()) return Rectangle(0, 0, 0, 0);
-    float min_x = points[0].x, max_x = points[0].x;
-    float min_y = points[0].y, max_y = points[0].y;
-    for (const Point& p : points) {
-        min_x = min(min_x, p.x);
-        max_x = max(max_x, p.x);
-        min_y = min(min_y, p.y);
-        max_y = max(max_y, p.y);
-    }
-    return Rectangle((min_x + max_x) / 2, (min_y + max_y) / 2, max_x - min_x, max_y - min_y);
+    return Rectangle::bounding(points);
 }
 
 Rectangle compute_boundary(const vector<RTree*>& nodes) {
@@ -252,14 +245,104 @@ vector<Point> RTree::range_query(const Rectangle& range_rect) const {
     return found;
 }
 
-vector<pair<Point, float>> RTree::knn_query(const Point& query, int k) const {
+// Appends every point stored in this subtree to out
+void RTree::collect_points(vector<Point>& out) const {
+    vector<const RTree*> stack{this};
+    while (!stack.empty()) {
+        const RTree* node = stack.back();
+        stack.pop_back();
+
+        if (node->is_leaf) {
+            out.insert(out.end(), node->points.begin(), node->points.end());
+        }
+        else {
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+    }
+}
+
+// Points inside an arbitrary simple polygon. Subtrees whose MBR lies entirely
+// inside the polygon are taken wholesale, disjoint ones are pruned.
+vector<Point> RTree::range_query(const Polygon& polygon) const {
+    vector<Point> found;
+    vector<const RTree*> stack{this};
+
+    while (!stack.empty()) {
+        const RTree* node = stack.back();
+        stack.pop_back();
+
+        if (!polygon.intersects(node->boundary))
+            continue;
+
+        if (polygon.contains_rectangle(node->boundary)) {
+            node->collect_points(found);
+        }
+        else if (node->is_leaf) {
+            for (const Point& p : node->points) {
+                if (polygon.contains(p)) {
+                    found.push_back(p);
+                }
+            }
+        }
+        else {
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+    }
+
+    return found;
+}
+
+// All points within radius of center. MINDIST prunes subtrees, MAXDIST accepts
+// them wholesale; everything is compared squared so no sqrt is taken.
+vector<Point> RTree::within_distance(const Point& center, float radius) const {
+    vector<Point> found;
+    if (radius < 0) return found;
+
+    float radius_sq = radius * radius;
+    vector<const RTree*> stack{this};
+
+    while (!stack.empty()) {
+        const RTree* node = stack.back();
+        stack.pop_back();
+
+        if (center.squared_distance_to_rectangle(node->boundary) > radius_sq)
+            continue;
+
+        if (center.max_squared_distance_to_rectangle(node->boundary) <= radius_sq) {
+            node->collect_points(found);
+        }
+        else if (node->is_leaf) {
+            for (const Point& p : node->points) {
+                if (center.squared_distance_to_point(p) <= radius_sq) {
+                    found.push_back(p);
+                }
+            }
+        }
+        else {
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+    }
+
+    return found;
+}
+
+vector<pair<Point, float>> RTree::knn_query(const Point& query, int k, float slack) const {
     priority_queue<HeapEntry<RTree>> heap;
     vector<pair<Point, float>> results;
     int counter = 0;
+    size_t limit = max(k, 0);
 
     heap.emplace(query.distance_to_rectangle(boundary), counter++, this);
 
-    while (!heap.empty() && results.size() < k) {
+    // Past k results, keep popping points within slack of the k-th distance
+    while (!heap.empty() && (results.size() < limit ||
+           (slack > 0 && limit > 0 && heap.top().dist <= results[limit - 1].second + slack))) {
         HeapEntry<RTree> entry = heap.top();
         heap.pop();
 
@@ -288,6 +371,281 @@ vector<pair<Point, float>> RTree::knn_query(const Point& query, int k) const {
     return results;
 }
 
+// Approximate k-NN. A node is pruned once its MINDIST * (1 + epsilon) exceeds
+// the k-th best point distance seen so far, so every returned neighbor is within
+// a factor (1 + epsilon) of the true one. max_visited_nodes / max_visited_leaves
+// (0 = unlimited) additionally cap the work done per query. exact reports whether
+// any pruned or capped node could have held a closer point.
+ApproxKnnResult RTree::knn_query_approx(const Point& query, int k, float epsilon, int max_visited_nodes, int max_visited_leaves) const {
+    priority_queue<HeapEntry<RTree>> heap;
+    priority_queue<float> best; // max-heap of the k smallest point distances seen
+    ApproxKnnResult result{{}, true, 0, 0};
+    int counter = 0;
+    size_t limit = max(k, 0);
+
+    heap.emplace(query.distance_to_rectangle(boundary), counter++, this);
+
+    while (!heap.empty() && result.neighbors.size() < limit) {
+        HeapEntry<RTree> entry = heap.top();
+        heap.pop();
+
+        if (holds_alternative<Point>(entry.data)) {
+            result.neighbors.emplace_back(get<Point>(entry.data), entry.dist);
+            continue;
+        }
+
+        const RTree* node = get<const RTree*>(entry.data);
+        float kth = best.size() < limit ? numeric_limits<float>::infinity() : best.top();
+        bool leaf = node->is_leaf;
+
+        bool over_budget = (max_visited_nodes > 0 && result.visited_nodes >= max_visited_nodes) ||
+                           (leaf && max_visited_leaves > 0 && result.visited_leaves >= max_visited_leaves);
+        if (over_budget || entry.dist * (1.0f + epsilon) > kth) {
+            if (entry.dist < kth) result.exact = false;
+            continue;
+        }
+
+        result.visited_nodes++;
+        if (leaf) {
+            result.visited_leaves++;
+            for (const Point& p : node->points) {
+                float dist = query.distance_to_point(p);
+                if (best.size() < limit) {
+                    best.push(dist);
+                }
+                else if (dist < best.top()) {
+                    best.pop();
+                    best.push(dist);
+                }
+                else if (dist > best.top()) {
+                    continue; // can never make it into the result
+                }
+                heap.emplace(dist, counter++, p);
+            }
+        }
+        else {
+            for (RTree* child : node->children) {
+                heap.emplace(query.distance_to_rectangle(child->boundary), counter++, child);
+            }
+        }
+    }
+
+    return result;
+}
+
+// Batched range queries, software-pipelined over up to group_size queries.
+// Each query is a small state machine that only reads memory prefetched at
+// least one turn earlier:
+//   FETCH:   pop nodes (prefetched when they were pushed) and drop those whose
+//            MBR misses the range; prefetch the points / children buffer of
+//            the first one that intersects
+//   PAYLOAD: scan its points, or push its children and prefetch them
+// Every other in-flight query takes a turn in between, so each prefetch has a
+// full round to arrive and the misses of different queries overlap.
+vector<vector<Point>> RTree::range_query_batch(const vector<Rectangle>& ranges, int group_size) const {
+    enum Stage { FETCH, PAYLOAD };
+    struct Slot {
+        size_t query;
+        vector<const RTree*> stack;
+        const RTree* node;
+        Stage stage;
+        bool done;
+    };
+
+    vector<vector<Point>> results(ranges.size());
+    size_t group = min(static_cast<size_t>(max(group_size, 1)), ranges.size());
+    vector<Slot> slots(group);
+    size_t next_query = 0;
+    size_t active = group;
+
+    auto start = [&](Slot& slot) {
+        slot.query = next_query++;
+        slot.stack.assign(1, this);
+        slot.node = nullptr;
+        slot.stage = FETCH;
+        slot.done = false;
+    };
+    for (Slot& slot : slots) start(slot);
+
+    while (active > 0) {
+        for (Slot& slot : slots) {
+            if (slot.done) continue;
+
+            const Rectangle& range_rect = ranges[slot.query];
+
+            if (slot.stage == FETCH) {
+                slot.node = nullptr;
+                while (!slot.stack.empty()) {
+                    const RTree* candidate = slot.stack.back();
+                    slot.stack.pop_back();
+                    if (candidate->boundary.intersects(range_rect)) {
+                        slot.node = candidate;
+                        break;
+                    }
+                }
+
+                if (!slot.node) {
+                    if (next_query < ranges.size()) {
+                        start(slot);
+                    } else {
+                        slot.done = true;
+                        active--;
+                    }
+                    continue;
+                }
+
+                if (slot.node->is_leaf) {
+                    prefetch_range(slot.node->points.data(), slot.node->points.size() * sizeof(Point));
+                } else {
+                    prefetch_range(slot.node->children.data(), slot.node->children.size() * sizeof(RTree*));
+                }
+                slot.stage = PAYLOAD;
+            }
+            else {
+                const RTree* node = slot.node;
+                if (node->is_leaf) {
+                    for (const Point& p : node->points) {
+                        if (range_rect.contains(p)) {
+                            results[slot.query].push_back(p);
+                        }
+                    }
+                } else {
+                    // Push in reverse so results come out in the same order as range_query
+                    for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                        __builtin_prefetch(*it);
+                        slot.stack.push_back(*it);
+                    }
+                }
+                slot.stage = FETCH;
+            }
+        }
+    }
+
+    return results;
+}
+
+// Batched k-NN queries, pipelined like range_query_batch. Each slot keeps only
+// nodes in its traversal heap; points go to an unsorted candidate buffer that
+// is cut back to the k nearest (nth_element) whenever it reaches 2k. The k-th
+// distance of the last cut bounds the search, so points and nodes beyond it
+// are dropped right away. Expanding an internal node takes one more turn,
+// because its children have to be prefetched before their MBRs can be read:
+//   FETCH:    pop the nearest node (prefetched when its parent was expanded)
+//             unless it is no closer than the bound, which ends the query;
+//             prefetch its points / children
+//   PAYLOAD:  offer the points to the candidates, or prefetch the children
+//   CHILDREN: push the children closer than the bound
+// Points tied with the k-th distance may be chosen differently than by
+// knn_query; the distances returned are the same.
+vector<vector<pair<Point, float>>> RTree::knn_query_batch(const vector<Point>& queries, int k, int group_size) const {
+    enum Stage { FETCH, PAYLOAD, CHILDREN };
+    typedef pair<float, const RTree*> NodeEntry;
+    struct Slot {
+        size_t query;
+        vector<NodeEntry> nodes;          // min-heap on MINDIST, reused across the slot's queries
+        vector<pair<Point, float>> best;  // candidates, at most 2k
+        float bound;                      // k-th distance at the last cut
+        const RTree* node;
+        Stage stage;
+        bool done;
+    };
+
+    vector<vector<pair<Point, float>>> results(queries.size());
+    size_t limit = max(k, 0);
+    size_t group = min(static_cast<size_t>(max(group_size, 1)), queries.size());
+    vector<Slot> slots(group);
+    size_t next_query = 0;
+    size_t active = group;
+
+    auto nearer = [](const pair<Point, float>& a, const pair<Point, float>& b) { return a.second < b.second; };
+    auto cut = [&](Slot& slot) {
+        nth_element(slot.best.begin(), slot.best.begin() + (limit - 1), slot.best.end(), nearer);
+        slot.best.erase(slot.best.begin() + limit, slot.best.end());
+        slot.bound = slot.best.back().second;
+    };
+    auto offer = [&](Slot& slot, float dist, const Point& p) {
+        if (dist < slot.bound) {
+            slot.best.emplace_back(p, dist);
+            if (slot.best.size() >= 2 * limit) cut(slot);
+        }
+    };
+    auto push = [](Slot& slot, float dist, const RTree* node) {
+        slot.nodes.emplace_back(dist, node);
+        push_heap(slot.nodes.begin(), slot.nodes.end(), greater<NodeEntry>());
+    };
+    auto start = [&](Slot& slot) {
+        slot.query = next_query++;
+        slot.nodes.clear();
+        slot.best.clear();
+        slot.bound = numeric_limits<float>::infinity();
+        slot.node = nullptr;
+        slot.stage = FETCH;
+        slot.done = false;
+        if (limit > 0) push(slot, queries[slot.query].distance_to_rectangle(boundary), this);
+    };
+    for (Slot& slot : slots) start(slot);
+
+    while (active > 0) {
+        for (Slot& slot : slots) {
+            if (slot.done) continue;
+
+            const Point& query = queries[slot.query];
+            const RTree* node = slot.node;
+
+            switch (slot.stage) {
+                case FETCH:
+                    if (slot.nodes.empty() || slot.nodes.front().first >= slot.bound) {
+                        if (slot.best.size() > limit) cut(slot);
+                        sort(slot.best.begin(), slot.best.end(), nearer);
+                        results[slot.query] = move(slot.best);
+                        slot.best = vector<pair<Point, float>>();
+                        if (next_query < queries.size()) {
+                            start(slot);
+                        } else {
+                            slot.done = true;
+                            active--;
+                        }
+                        break;
+                    }
+                    node = slot.node = slot.nodes.front().second;
+                    pop_heap(slot.nodes.begin(), slot.nodes.end(), greater<NodeEntry>());
+                    slot.nodes.pop_back();
+                    if (node->is_leaf) {
+                        prefetch_range(node->points.data(), node->points.size() * sizeof(Point));
+                    } else {
+                        prefetch_range(node->children.data(), node->children.size() * sizeof(RTree*));
+                    }
+                    slot.stage = PAYLOAD;
+                    break;
+
+                case PAYLOAD:
+                    if (node->is_leaf) {
+                        for (const Point& p : node->points) {
+                            offer(slot, query.distance_to_point(p), p);
+                        }
+                        slot.stage = FETCH;
+                    } else {
+                        for (RTree* child : node->children) {
+                            __builtin_prefetch(child);
+                        }
+                        slot.stage = CHILDREN;
+                    }
+                    break;
+
+                case CHILDREN:
+                    for (RTree* child : node->children) {
+                        float dist = query.distance_to_rectangle(child->boundary);
+                        if (dist < slot.bound) push(slot, dist, child);
+                    }
+                    slot.stage = FETCH;
+                    break;
+            }
+        }
+    }
+
+    return results;
+}
+
 void RTree::print_tree(int depth) const {
     string indent(depth * 2, ' '); // 2 spaces per level
     cout << indent << "Node (is_leaf: " << is_leaf << ", boundary: ["
@@ -312,19 +670,7 @@ int RTree::get_depth() const {
     return 1 + children[0]->get_depth();
 }
 float RTree::get_avg_occupancy() const {
-    vector<int> occupancies;
-    function<void(const RTree*)> collect = [&](const RTree* node) {
-        if (node->is_leaf) {
-            occupancies.push_back(node->points.size());
-        } else {
-            occupancies.push_back(node->children.size());
-            for (RTree* child : node->children) {
-                collect(child);
-            }
-        }
-    };
-    collect(this);
-    return accumulate(occupancies.begin(), occupancies.end(), 0.0f) / occupancies.size();
+    return compute_stats(*this).avg_occupancy;
 }
 
 vector<float> RTree::get_avg_overlap_per_level() const {
@@ -333,68 +679,8 @@ vector<float> RTree::get_avg_overlap_per_level() const {
         return overlaps_per_level; // Empty tree
     }
 
-    // Use a queue for level-order traversal
-    queue<pair<const RTree*, int>> q;
-    vector<vector<const RTree*>> nodes_by_level;
-
-    // Start with the root at level 0
-    q.emplace(this, 0);
-    while (!q.empty()) {
-        auto [node, level] = q.front();
-        q.pop();
-
-        // Ensure nodes_by_level has enough space
-        if (level >= nodes_by_level.size()) {
-            nodes_by_level.resize(level + 1);
-        }
-        nodes_by_level[level].push_back(node);
-
-        // Add children to the queue
-        if (!node->is_leaf) {
-            for (const RTree* child : node->children) {
-                q.emplace(child, level + 1);
-            }
-        }
-    }
-
-    // Compute average overlap for each level
-    for (const auto& level_nodes : nodes_by_level) {
-        // Group nodes by parent to only compute overlaps between siblings
-        map<const RTree*, vector<const RTree*>> parent_to_nodes;
-        for (const RTree* node : level_nodes) {
-            // Find parent (or null for root)
-            const RTree* parent = nullptr;
-            for (const auto& level_above : nodes_by_level) {
-                for (const RTree* candidate : level_above) {
-                    if (!candidate->is_leaf && find(candidate->children.begin(), candidate->children.end(), node) != candidate->children.end()) {
-                        parent = candidate;
-                        break;
-                    }
-                }
-                if (parent) break;
-            }
-            parent_to_nodes[parent].push_back(node);
-        }
-
-        // Compute total overlap for this level
-        float total_overlap = 0.0f;
-        size_t node_count = level_nodes.size();
-        size_t pair_count = 0;
-
-        for (const auto& [parent, siblings] : parent_to_nodes) {
-            // Compute pairwise overlaps for siblings
-            for (size_t i = 0; i < siblings.size(); ++i) {
-                for (size_t j = i + 1; j < siblings.size(); ++j) {
-                    total_overlap += siblings[i]->boundary.intersection_area(siblings[j]->boundary);
-                    pair_count++;
-                }
-            }
-        }
-
-        // Compute average overlap per node
-        float avg_overlap = (node_count > 0 && pair_count > 0) ? total_overlap / node_count : 0.0f;
-        overlaps_per_level.push_back(avg_overlap);
+    for (const LevelStats& level : compute_stats(*this).levels) {
+        overlaps_per_level.push_back(level.avg_overlap);
     }
-
     return overlaps_per_level;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include "Point.h"
 #include "Rectangle.h"
+#include "ApproxKnn.h"
+#include "Polygon.h"
 #include <vector>
 #include <variant>
 
@@ -26,7 +28,14 @@ public:
     int get_depth() const;
     float get_avg_occupancy() const;
     vector<Point> range_query(const Rectangle& range_rect) const;
-    vector<pair<Point, float>> knn_query(const Point& query, int k) const;
+    vector<Point> range_query(const Polygon& polygon) const;
+    vector<Point> within_distance(const Point& center, float radius) const;
+    void collect_points(vector<Point>& out) const;
+    // With slack > 0, points up to the k-th distance + slack are returned as well
+    vector<pair<Point, float>> knn_query(const Point& query, int k, float slack = 0.0f) const;
+    ApproxKnnResult knn_query_approx(const Point& query, int k, float epsilon, int max_visited_nodes = 0, int max_visited_leaves = 0) const;
+    vector<vector<Point>> range_query_batch(const vector<Rectangle>& ranges, int group_size = 16) const;
+    vector<vector<pair<Point, float>>> knn_query_batch(const vector<Point>& queries, int k, int group_size = 16) const;
     vector<float> get_avg_overlap_per_level() const;
     variant<vector<Point>, vector<vector<Point>>> sort_points(const vector<Point>& points, float min_x, float max_x, float min_y, float max_y, SortMethod method) const;
         void insert_sorted(const variant<vector<Point>, vector<vector<Point>>>& sorted_data);
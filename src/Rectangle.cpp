@@ -11,6 +11,34 @@ Rectangle::Rectangle(float x_cord, float y_cord, float width, float height)
       top(y_cord + height / 2),
       bottom(y_cord - height / 2) {}
 
+// Keeps the given edges exactly. Going through center/size can move an edge by
+// an ulp, which is enough for an MBR to miss the point that defines it.
+Rectangle Rectangle::from_bounds(float left, float bottom, float right, float top) {
+    Rectangle rect((left + right) / 2, (bottom + top) / 2, right - left, top - bottom);
+    rect.left = left;
+    rect.right = right;
+    rect.bottom = bottom;
+    rect.top = top;
+    return rect;
+}
+
+// Smallest rectangle holding all points, each side pushed out by pad_fraction
+// of the larger extent. Trees built over points pass a small pad so points on
+// the border stay inside after subdivision rounding.
+Rectangle Rectangle::bounding(const vector<Point>& points, float pad_fraction) {
+    if (points.empty()) return Rectangle(0, 0, 0, 0);
+    float min_x = points[0].x, max_x = points[0].x;
+    float min_y = points[0].y, max_y = points[0].y;
+    for (const Point& p : points) {
+        min_x = min(min_x, p.x);
+        max_x = max(max_x, p.x);
+        min_y = min(min_y, p.y);
+        max_y = max(max_y, p.y);
+    }
+    float pad = pad_fraction > 0 ? max({max_x - min_x, max_y - min_y, 1e-6f}) * pad_fraction : 0.0f;
+    return from_bounds(min_x - pad, min_y - pad, max_x + pad, max_y + pad);
+}
+
 ostream& operator<<(ostream& os, const Rectangle& rect) {
     os << "Rectangle(x=" << rect.x << ", y=" << rect.y
        << ", w=" << rect.w << ", h=" << rect.h << ")";
@@ -34,11 +62,7 @@ Rectangle Rectangle::union_with(const Rectangle& other) const {
     float new_right = max(right, other.right);
     float new_bottom = min(bottom, other.bottom);
     float new_top = max(top, other.top);
-    float new_x = (new_left + new_right) / 2;
-    float new_y = (new_bottom + new_top) / 2;
-    float new_w = new_right - new_left;
-    float new_h = new_top - new_bottom;
-    return Rectangle(new_x, new_y, new_w, new_h);
+    return from_bounds(new_left, new_bottom, new_right, new_top);
 }
 
 float Rectangle::area() const {
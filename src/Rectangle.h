@@ -1,6 +1,7 @@
 #pragma once
 #include "Point.h"
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
@@ -10,6 +11,8 @@ public:
     float left, right, top, bottom;
 
     explicit Rectangle(float x_cord, float y_cord, float width, float height);
+    static Rectangle from_bounds(float left, float bottom, float right, float top);
+    static Rectangle bounding(const vector<Point>& points, float pad_fraction = 0.0f);
 
     bool contains(const Point& point) const;
     bool intersects(const Rectangle& rect) const;
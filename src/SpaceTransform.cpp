@@ -0,0 +1,136 @@
+#include "SpaceTransform.h"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+SpaceTransform::SpaceTransform(float center_x, float center_y, float angle)
+    : center_x(center_x), center_y(center_y), angle(angle),
+      cos_a(cos(angle)), sin_a(sin(angle)) {}
+
+ostream& operator<<(ostream& os, const SpaceTransform& transform) {
+    os << "SpaceTransform(center=(" << transform.center_x << ", " << transform.center_y
+       << "), angle=" << transform.angle << ")";
+    return os;
+}
+
+static void mean_of(const vector<Point>& points, double& mean_x, double& mean_y) {
+    mean_x = 0;
+    mean_y = 0;
+    for (const Point& p : points) {
+        mean_x += p.x;
+        mean_y += p.y;
+    }
+    if (!points.empty()) {
+        mean_x /= points.size();
+        mean_y /= points.size();
+    }
+}
+
+// Rotates the data so its first principal component lies along the x axis
+SpaceTransform SpaceTransform::fit_pca(const vector<Point>& points) {
+    double mean_x, mean_y;
+    mean_of(points, mean_x, mean_y);
+
+    double cxx = 0, cyy = 0, cxy = 0;
+    for (const Point& p : points) {
+        double dx = p.x - mean_x;
+        double dy = p.y - mean_y;
+        cxx += dx * dx;
+        cyy += dy * dy;
+        cxy += dx * dy;
+    }
+
+    // Orientation of the principal eigenvector of the 2x2 covariance matrix
+    float theta = 0.5 * atan2(2 * cxy, cxx - cyy);
+    return SpaceTransform(mean_x, mean_y, theta);
+}
+
+// Rotation by a fixed angle (radians) around the data mean, e.g. M_PI / 4
+SpaceTransform SpaceTransform::fit_angle(const vector<Point>& points, float angle) {
+    double mean_x, mean_y;
+    mean_of(points, mean_x, mean_y);
+    return SpaceTransform(mean_x, mean_y, angle);
+}
+
+Point SpaceTransform::apply(const Point& point) const {
+    float dx = point.x - center_x;
+    float dy = point.y - center_y;
+    return Point(point.id, cos_a * dx + sin_a * dy, -sin_a * dx + cos_a * dy);
+}
+
+Point SpaceTransform::invert(const Point& point) const {
+    return Point(point.id, cos_a * point.x - sin_a * point.y + center_x,
+                           sin_a * point.x + cos_a * point.y + center_y);
+}
+
+// Bulk versions: coordinates are split into flat arrays so the rotation loop
+// has no dependencies between iterations and is auto-vectorized.
+vector<Point> SpaceTransform::apply(const vector<Point>& points) const {
+    size_t n = points.size();
+    vector<float> xs(n), ys(n);
+    for (size_t i = 0; i < n; ++i) {
+        xs[i] = points[i].x - center_x;
+        ys[i] = points[i].y - center_y;
+    }
+
+    const float c = cos_a, s = sin_a;
+    float* __restrict__ px = xs.data();
+    float* __restrict__ py = ys.data();
+    for (size_t i = 0; i < n; ++i) {
+        float x = px[i], y = py[i];
+        px[i] = c * x + s * y;
+        py[i] = -s * x + c * y;
+    }
+
+    vector<Point> out;
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        out.emplace_back(points[i].id, px[i], py[i]);
+    }
+    return out;
+}
+
+vector<Point> SpaceTransform::invert(const vector<Point>& points) const {
+    size_t n = points.size();
+    vector<float> xs(n), ys(n);
+    for (size_t i = 0; i < n; ++i) {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+
+    const float c = cos_a, s = sin_a, cx = center_x, cy = center_y;
+    float* __restrict__ px = xs.data();
+    float* __restrict__ py = ys.data();
+    for (size_t i = 0; i < n; ++i) {
+        float x = px[i], y = py[i];
+        px[i] = c * x - s * y + cx;
+        py[i] = s * x + c * y + cy;
+    }
+
+    vector<Point> out;
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        out.emplace_back(points[i].id, px[i], py[i]);
+    }
+    return out;
+}
+
+// An axis-aligned rectangle in the original space is a rotated rectangle here.
+// A margin grows it on every side after rotating, where it is not lost to the
+// rounding of large original coordinates.
+Polygon SpaceTransform::apply(const Rectangle& rect, float margin) const {
+    // The original x and y axes in the rotated space, scaled by the margin
+    float ux = margin * cos_a, uy = -margin * sin_a;
+    float vx = margin * sin_a, vy = margin * cos_a;
+
+    Point corners[4] = {apply(Point(0, rect.left, rect.bottom)), apply(Point(1, rect.right, rect.bottom)),
+                        apply(Point(2, rect.right, rect.top)), apply(Point(3, rect.left, rect.top))};
+    const float sx[4] = {-1, 1, 1, -1};
+    const float sy[4] = {-1, -1, 1, 1};
+    vector<Point> vertices;
+    for (int i = 0; i < 4; ++i) {
+        vertices.emplace_back(i, corners[i].x + sx[i] * ux + sy[i] * vx, corners[i].y + sx[i] * uy + sy[i] * vy);
+    }
+    return Polygon(vertices);
+}
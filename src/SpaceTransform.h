@@ -0,0 +1,30 @@
+#pragma once
+#include "Point.h"
+#include "Rectangle.h"
+#include "Polygon.h"
+#include <vector>
+
+using namespace std;
+
+// Rigid rotation of the data space around a center. Distances are preserved,
+// so k-NN results are the same in either space; axis-aligned rectangles become
+// rotated polygons.
+class SpaceTransform {
+public:
+    float center_x, center_y;
+    float angle;
+    float cos_a, sin_a;
+
+    explicit SpaceTransform(float center_x = 0, float center_y = 0, float angle = 0);
+
+    static SpaceTransform fit_pca(const vector<Point>& points);
+    static SpaceTransform fit_angle(const vector<Point>& points, float angle);
+
+    Point apply(const Point& point) const;
+    Point invert(const Point& point) const;
+    vector<Point> apply(const vector<Point>& points) const;
+    vector<Point> invert(const vector<Point>& points) const;
+    Polygon apply(const Rectangle& rect, float margin = 0.0f) const;
+};
+
+ostream& operator<<(ostream& os, const SpaceTransform& transform);
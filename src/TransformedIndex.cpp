@@ -0,0 +1,30 @@
+#include "TransformedIndex.h"
+
+using namespace std;
+
+// Rotated copies of the points, identified by their index into points
+static vector<Point> rotate_indexed(const vector<Point>& points, const SpaceTransform& transform) {
+    vector<Point> rotated = transform.apply(points);
+    for (size_t i = 0; i < rotated.size(); ++i) {
+        rotated[i].id = static_cast<int>(i);
+    }
+    return rotated;
+}
+
+TransformedIndex<QuadTree> build_transformed_quadtree(const vector<Point>& points, int capacity, const SpaceTransform& transform) {
+    vector<Point> rotated = rotate_indexed(points, transform);
+    Rectangle boundary = Rectangle::bounding(rotated, 1e-4f);
+
+    auto tree = make_unique<QuadTree>(boundary, capacity);
+    for (const Point& p : rotated) {
+        tree->insert(p);
+    }
+    return TransformedIndex<QuadTree>(transform, move(tree), points);
+}
+
+TransformedIndex<RTree> build_transformed_rtree(const vector<Point>& points, int min_entries, int max_entries,
+                                                SortMethod method, const SpaceTransform& transform) {
+    auto tree = make_unique<RTree>(Rectangle(0, 0, 0, 0), min_entries, max_entries);
+    tree->insert(rotate_indexed(points, transform), method);
+    return TransformedIndex<RTree>(transform, move(tree), points);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "SpaceTransform.h"
+#include "QuadTree.h"
+#include "RTree.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Wraps a QuadTree or RTree built over rotated data. Queries are given and
+// answered in the original space. The rotated tree only supplies candidates,
+// which are then checked against the original points (kept in a parallel
+// array, the rotated copies carry their index as id). Results are therefore
+// the same as on an unrotated tree, despite the float rounding of the rotation.
+template <typename Tree>
+class TransformedIndex {
+public:
+    SpaceTransform transform;
+    unique_ptr<Tree> tree;
+    vector<Point> originals;
+
+    TransformedIndex(const SpaceTransform& transform, unique_ptr<Tree> tree, vector<Point> originals)
+        : transform(transform), tree(move(tree)), originals(move(originals)) {}
+
+    // Candidates come from the rotated range, grown by more than rounding can
+    // move a point, so none rounded across its border are lost
+    vector<Point> range_query(const Rectangle& range_rect) const {
+        // |dx| + |dy| of the farthest corner bounds the rotated coordinates
+        float magnitude = max(fabs(range_rect.left - transform.center_x), fabs(range_rect.right - transform.center_x)) +
+                          max(fabs(range_rect.bottom - transform.center_y), fabs(range_rect.top - transform.center_y));
+        float margin = slack(magnitude) + numeric_limits<float>::min();
+
+        // Filtered in place, the candidates are swapped for their originals
+        vector<Point> found = tree->range_query(transform.apply(range_rect, margin));
+        size_t kept = 0;
+        for (size_t i = 0; i < found.size(); ++i) {
+            const Point& p = originals[found[i].id];
+            if (range_rect.contains(p)) {
+                found[kept++] = p;
+            }
+        }
+        found.erase(found.begin() + kept, found.end());
+        return found;
+    }
+
+    vector<Point> within_distance(const Point& center, float radius) const {
+        vector<Point> found;
+        if (radius < 0) return found;
+
+        Point rotated = transform.apply(center);
+        float reach = radius + slack(fabs(rotated.x) + fabs(rotated.y) + radius);
+        float radius_sq = radius * radius;
+        for (const Point& candidate : tree->within_distance(rotated, reach)) {
+            const Point& p = originals[candidate.id];
+            if (center.squared_distance_to_point(p) <= radius_sq) {
+                found.push_back(p);
+            }
+        }
+        return found;
+    }
+
+    // Rotation keeps distances, so one k-NN query on the tree suffices. Only its
+    // rounding can reorder near-ties around the k-th distance, so the tree also
+    // returns the points within slack of it, and the k nearest of those by
+    // original distance are the exact answer.
+    vector<pair<Point, float>> knn_query(const Point& query, int k) const {
+        Point rotated = transform.apply(query);
+        const Rectangle& extent = tree->boundary;
+        float magnitude = max({fabs(extent.left), fabs(extent.right), fabs(extent.bottom), fabs(extent.top)}) +
+                          fabs(rotated.x) + fabs(rotated.y);
+
+        vector<pair<Point, float>> results = tree->knn_query(rotated, k, 2 * slack(magnitude));
+        for (auto& [p, dist] : results) {
+            p = originals[p.id];
+            dist = query.distance_to_point(p);
+        }
+
+        size_t limit = min(results.size(), static_cast<size_t>(max(k, 0)));
+        partial_sort(results.begin(), results.begin() + limit, results.end(),
+                     [](const pair<Point, float>& a, const pair<Point, float>& b) { return a.second < b.second; });
+        results.erase(results.begin() + limit, results.end());
+        return results;
+    }
+
+    // Bound on how far rotating a coordinate of the given magnitude can move it
+    static float slack(float magnitude) {
+        return 32 * numeric_limits<float>::epsilon() * magnitude;
+    }
+};
+
+TransformedIndex<QuadTree> build_transformed_quadtree(const vector<Point>& points, int capacity, const SpaceTransform& transform);
+TransformedIndex<RTree> build_transformed_rtree(const vector<Point>& points, int min_entries, int max_entries,
+                                                SortMethod method, const SpaceTransform& transform);
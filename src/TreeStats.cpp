@@ -0,0 +1,279 @@
+#include "TreeStats.h"
+#include "RTree.h"
+#include "QuadTree.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <future>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+struct LevelAccumulator {
+    long long nodes = 0;
+    double total_area = 0;
+    double overlap = 0;
+    long long sibling_pairs = 0;
+    double dead_space = 0;
+};
+
+struct StatsAccumulator {
+    int min_depth = INT_MAX;
+    int max_depth = 0;
+    long long total_nodes = 0;
+    long long internal_nodes = 0;
+    long long total_entries = 0;
+    long long total_points = 0;
+    double leaf_sum_sq = 0;
+    map<int, int> leaf_occupancy;
+    map<int, int> internal_occupancy;
+    vector<LevelAccumulator> levels;
+    size_t memory_bytes = 0;
+
+    LevelAccumulator& level(int depth) {
+        if (depth >= static_cast<int>(levels.size())) levels.resize(depth + 1);
+        return levels[depth];
+    }
+
+    void merge(const StatsAccumulator& other) {
+        min_depth = min(min_depth, other.min_depth);
+        max_depth = max(max_depth, other.max_depth);
+        total_nodes += other.total_nodes;
+        internal_nodes += other.internal_nodes;
+        total_entries += other.total_entries;
+        total_points += other.total_points;
+        leaf_sum_sq += other.leaf_sum_sq;
+        for (const auto& [size, count] : other.leaf_occupancy) leaf_occupancy[size] += count;
+        for (const auto& [size, count] : other.internal_occupancy) internal_occupancy[size] += count;
+        for (size_t d = 0; d < other.levels.size(); ++d) {
+            LevelAccumulator& mine = level(d);
+            mine.nodes += other.levels[d].nodes;
+            mine.total_area += other.levels[d].total_area;
+            mine.overlap += other.levels[d].overlap;
+            mine.sibling_pairs += other.levels[d].sibling_pairs;
+            mine.dead_space += other.levels[d].dead_space;
+        }
+        memory_bytes += other.memory_bytes;
+    }
+};
+
+// Node adapters, so the traversal below is shared by both trees
+
+bool is_leaf(const RTree* node) { return node->is_leaf; }
+bool is_leaf(const QuadTree* node) { return !node->divided; }
+
+void get_children(const RTree* node, vector<const RTree*>& out) {
+    out.assign(node->children.begin(), node->children.end());
+}
+void get_children(const QuadTree* node, vector<const QuadTree*>& out) {
+    out.clear();
+    for (const QuadTree* child : {node->northwest, node->northeast, node->southwest, node->southeast}) {
+        if (child) out.push_back(child);
+    }
+}
+
+size_t node_bytes(const RTree* node) {
+    return sizeof(RTree) + node->points.capacity() * sizeof(Point) + node->children.capacity() * sizeof(RTree*);
+}
+size_t node_bytes(const QuadTree* node) {
+    size_t bytes = sizeof(QuadTree) + node->points.capacity() * sizeof(Point);
+    if (node->overflow_ids) {
+        // Bucket array plus one heap node (next pointer and id) per entry
+        bytes += sizeof(unordered_set<int>) + node->overflow_ids->bucket_count() * sizeof(void*) +
+                 node->overflow_ids->size() * (sizeof(void*) + sizeof(int));
+    }
+    return bytes;
+}
+
+// An empty QuadTree quadrant is dead space even though its boundary tiles the parent
+bool covers_area(const RTree*) { return true; }
+bool covers_area(const QuadTree* node) { return node->divided || !node->points.empty(); }
+
+// Visits one node: its own counters plus the sibling overlap and dead space of
+// its children, which is why no parent lookup is ever needed.
+template <typename Node>
+void visit(const Node* node, int depth, StatsAccumulator& acc, vector<const Node*>& children) {
+    LevelAccumulator& here = acc.level(depth);
+    here.nodes++;
+    here.total_area += node->boundary.area();
+    acc.total_nodes++;
+    acc.memory_bytes += node_bytes(node);
+
+    if (is_leaf(node)) {
+        int n = node->points.size();
+        children.clear();
+        acc.min_depth = min(acc.min_depth, depth);
+        acc.max_depth = max(acc.max_depth, depth);
+        acc.total_entries += n;
+        acc.total_points += n;
+        acc.leaf_sum_sq += static_cast<double>(n) * n;
+        acc.leaf_occupancy[n]++;
+        return;
+    }
+
+    get_children(node, children);
+    acc.internal_nodes++;
+    acc.total_entries += children.size();
+    acc.internal_occupancy[children.size()]++;
+
+    double overlap = 0, covered = 0, covered_overlap = 0;
+    for (size_t i = 0; i < children.size(); ++i) {
+        bool covers_i = covers_area(children[i]);
+        if (covers_i) covered += children[i]->boundary.area();
+        for (size_t j = i + 1; j < children.size(); ++j) {
+            float area = children[i]->boundary.intersection_area(children[j]->boundary);
+            overlap += area;
+            if (covers_i && covers_area(children[j])) covered_overlap += area;
+        }
+    }
+
+    LevelAccumulator& below = acc.level(depth + 1);
+    below.overlap += overlap;
+    below.sibling_pairs += children.size() * (children.size() - 1) / 2;
+    // Inclusion-exclusion up to pairwise terms, clamped to the parent's area
+    double parent_area = node->boundary.area();
+    double union_area = min(parent_area, max(0.0, covered - covered_overlap));
+    below.dead_space += parent_area - union_area;
+}
+
+template <typename Node>
+void traverse(const Node* root, int depth, StatsAccumulator& acc) {
+    vector<pair<const Node*, int>> stack{{root, depth}};
+    vector<const Node*> children;
+    while (!stack.empty()) {
+        auto [node, d] = stack.back();
+        stack.pop_back();
+        visit(node, d, acc, children);
+        for (const Node* child : children) {
+            stack.emplace_back(child, d + 1);
+        }
+    }
+}
+
+// k-th smallest leaf size (0-based), read straight off the histogram
+float leaf_size_at(const map<int, int>& histogram, long long k) {
+    long long seen = 0;
+    for (const auto& [size, count] : histogram) {
+        seen += count;
+        if (k < seen) return size;
+    }
+    return 0.0f;
+}
+
+template <typename Node>
+TreeStats compute(const Node* root, int threads) {
+    StatsAccumulator acc;
+
+    vector<const Node*> children;
+    if (threads > 1 && !is_leaf(root)) {
+        visit(root, 0, acc, children);
+
+        int tasks = min(threads, static_cast<int>(children.size()));
+        vector<future<StatsAccumulator>> futures;
+        for (int t = 0; t < tasks; ++t) {
+            futures.push_back(async(launch::async, [&children, t, tasks]() {
+                StatsAccumulator partial;
+                for (size_t i = t; i < children.size(); i += tasks) {
+                    traverse(children[i], 1, partial);
+                }
+                return partial;
+            }));
+        }
+        for (auto& f : futures) {
+            acc.merge(f.get());
+        }
+    } else {
+        traverse(root, 0, acc);
+    }
+
+    TreeStats stats;
+    int total_leaves = acc.total_nodes - acc.internal_nodes;
+    stats.total_nodes = acc.total_nodes;
+    stats.internal_nodes = acc.internal_nodes;
+    stats.total_leaves = total_leaves;
+    stats.total_points = acc.total_points;
+    stats.min_depth = acc.min_depth == INT_MAX ? 0 : acc.min_depth;
+    stats.max_depth = acc.max_depth;
+    stats.avg_occupancy = acc.total_nodes > 0 ? static_cast<float>(acc.total_entries) / acc.total_nodes : 0.0f;
+
+    double mean = total_leaves > 0 ? static_cast<double>(acc.total_points) / total_leaves : 0.0;
+    stats.avg_points_per_leaf = mean;
+    stats.stddev_points_per_leaf = total_leaves > 1
+        ? sqrt(max(0.0, (acc.leaf_sum_sq - total_leaves * mean * mean) / (total_leaves - 1)))
+        : 0.0f;
+
+    // Same quartile positions QuadTree::collect_stats has always used
+    int mid = total_leaves / 2;
+    stats.q1_points_per_leaf = leaf_size_at(acc.leaf_occupancy, mid / 2);
+    stats.median_points_per_leaf = leaf_size_at(acc.leaf_occupancy, mid);
+    stats.q3_points_per_leaf = leaf_size_at(acc.leaf_occupancy, (mid + total_leaves) / 2);
+
+    stats.leaf_occupancy = move(acc.leaf_occupancy);
+    stats.internal_occupancy = move(acc.internal_occupancy);
+    for (const LevelAccumulator& level : acc.levels) {
+        float avg_overlap = (level.nodes > 0 && level.sibling_pairs > 0) ? level.overlap / level.nodes : 0.0f;
+        stats.levels.push_back(LevelStats{static_cast<int>(level.nodes), static_cast<float>(level.total_area),
+                                          static_cast<float>(level.overlap), static_cast<int>(level.sibling_pairs),
+                                          avg_overlap, static_cast<float>(level.dead_space)});
+    }
+    stats.memory_bytes = acc.memory_bytes;
+    return stats;
+}
+
+void write_histogram(ostringstream& out, const map<int, int>& histogram) {
+    out << "{";
+    bool first = true;
+    for (const auto& [size, count] : histogram) {
+        if (!first) out << ", ";
+        out << "\"" << size << "\": " << count;
+        first = false;
+    }
+    out << "}";
+}
+
+} // namespace
+
+TreeStats compute_stats(const RTree& tree, int threads) {
+    return compute(&tree, threads);
+}
+
+TreeStats compute_stats(const QuadTree& tree, int threads) {
+    return compute(&tree, threads);
+}
+
+string TreeStats::to_json() const {
+    ostringstream out;
+    out << "{\"total_nodes\": " << total_nodes
+        << ", \"internal_nodes\": " << internal_nodes
+        << ", \"total_leaves\": " << total_leaves
+        << ", \"total_points\": " << total_points
+        << ", \"min_depth\": " << min_depth
+        << ", \"max_depth\": " << max_depth
+        << ", \"avg_occupancy\": " << avg_occupancy
+        << ", \"avg_points_per_leaf\": " << avg_points_per_leaf
+        << ", \"stddev_points_per_leaf\": " << stddev_points_per_leaf
+        << ", \"q1_points_per_leaf\": " << q1_points_per_leaf
+        << ", \"median_points_per_leaf\": " << median_points_per_leaf
+        << ", \"q3_points_per_leaf\": " << q3_points_per_leaf
+        << ", \"memory_bytes\": " << memory_bytes
+        << ", \"leaf_occupancy\": ";
+    write_histogram(out, leaf_occupancy);
+    out << ", \"internal_occupancy\": ";
+    write_histogram(out, internal_occupancy);
+    out << ", \"levels\": [";
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const LevelStats& level = levels[i];
+        if (i > 0) out << ", ";
+        out << "{\"level\": " << i
+            << ", \"nodes\": " << level.nodes
+            << ", \"total_area\": " << level.total_area
+            << ", \"overlap\": " << level.overlap
+            << ", \"sibling_pairs\": " << level.sibling_pairs
+            << ", \"avg_overlap\": " << level.avg_overlap
+            << ", \"dead_space\": " << level.dead_space << "}";
+    }
+    out << "]}";
+    return out.str();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+class QuadTree;
+class RTree;
+
+struct LevelStats {
+    int nodes;
+    float total_area;    // sum of node MBR areas on this level
+    float overlap;       // pairwise overlap area between siblings on this level
+    int sibling_pairs;
+    float avg_overlap;   // overlap / nodes, 0 if the level has no sibling pairs
+    float dead_space;    // area of the parents not covered by their children on this level
+};
+
+struct TreeStats {
+    int total_nodes;
+    int internal_nodes;
+    int total_leaves;
+    int total_points;
+    int min_depth;       // shallowest leaf, root is depth 0
+    int max_depth;       // deepest leaf
+    float avg_occupancy; // entries (points or children) per node
+    float avg_points_per_leaf;
+    float stddev_points_per_leaf;
+    float q1_points_per_leaf;
+    float median_points_per_leaf;
+    float q3_points_per_leaf;
+    map<int, int> leaf_occupancy;      // points per leaf -> number of leaves
+    map<int, int> internal_occupancy;  // children per internal node -> number of nodes
+    vector<LevelStats> levels;
+    size_t memory_bytes;
+
+    string to_json() const;
+};
+
+// Computes every statistic in one parent-aware traversal. With threads > 1 the
+// root's subtrees are split across std::async tasks. The trees are only read,
+// so this can run alongside other readers of a live index.
+TreeStats compute_stats(const RTree& tree, int threads = 1);
+TreeStats compute_stats(const QuadTree& tree, int threads = 1);
@@ -0,0 +1,50 @@
+#include "Harness.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Differential check of every index variant against the naive scan:
+//
+//   harness <points.csv> [ranges.csv] [knn_points.csv]
+//
+// Range queries ("x,y,w,h") and k-NN query points ("x,y") are read from the
+// optional files, or generated at random when missing; adversarial ones are
+// always added. Some points are duplicated in place so ties and overflow
+// buckets are exercised. Exits with 1 on any mismatch.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " <points.csv> [ranges.csv] [knn_points.csv]\n";
+        return 2;
+    }
+
+    vector<Point> points = load_points(argv[1]);
+    if (points.empty()) {
+        cerr << "no points loaded from " << argv[1] << "\n";
+        return 2;
+    }
+    points = with_duplicates(points, 20, 1000);
+
+    QueryGenerator generator(points);
+
+    vector<Rectangle> ranges = argc > 2 ? load_rectangles(argv[2]) : generator.random_ranges(1000, 1e-4f, 1e-2f);
+    vector<Rectangle> adversarial_ranges = generator.adversarial_ranges(points, 200);
+    ranges.insert(ranges.end(), adversarial_ranges.begin(), adversarial_ranges.end());
+
+    vector<Point> knn_queries = argc > 3 ? load_points(argv[3]) : generator.random_points(500);
+    vector<Point> adversarial_points = generator.adversarial_points(points, 100);
+    knn_queries.insert(knn_queries.end(), adversarial_points.begin(), adversarial_points.end());
+
+    cout << points.size() << " points, " << ranges.size() << " range queries, "
+         << knn_queries.size() << " k-NN queries\n";
+
+    vector<VariantReport> reports = run_harness(points, standard_variants(points), ranges, knn_queries,
+                                                {1, 3, 50, 1000}, &cerr);
+    print_report(cout, reports);
+
+    size_t mismatches = 0;
+    for (const VariantReport& report : reports) {
+        mismatches += report.range_mismatches + report.knn_mismatches;
+    }
+    return mismatches == 0 ? 0 : 1;
+}